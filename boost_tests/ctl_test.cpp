@@ -0,0 +1,173 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE ctl
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+#include "utils.h"
+#include "CTL/CTLEngine.h"
+
+using namespace PetriEngine;
+using namespace PetriEngine::Colored;
+using namespace PetriEngine::PQL;
+namespace utf = boost::unit_test;
+
+namespace {
+    const std::set<size_t> queries{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+    /**
+     * Loads the net and the CTL queries as main does before calling CTLMain:
+     * the queries are translated from CTL*, indexed and the negations pushed,
+     * which also rewrites the globally operators.
+     */
+    auto load_ctl(const char* model, const char* file)
+    {
+        shared_string_set sset;
+        ColoredPetriNetBuilder cpnBuilder(sset);
+        auto f = loadFile(model);
+        cpnBuilder.parse_model(f);
+        auto [builder, trans_names, place_names] = unfold(cpnBuilder, false, false, false, std::cerr, 10, 100, 10, 10, false);
+        builder.sort();
+        auto q = loadFile(file);
+        std::vector<std::string> names;
+        auto conditions = getCTLQueries(parseXMLQueries(sset, names, q, queries, false));
+        std::unique_ptr<PetriNet> pn{builder.makePetriNet()};
+        contextAnalysis(false, trans_names, place_names, builder, pn.get(), conditions);
+        std::unique_ptr<MarkVal[]> m0(pn->makeInitialMarking());
+        EvaluationContext context(m0.get(), pn.get());
+        for(auto& c : conditions)
+        {
+            negstat_t stats;
+            c = pushNegation(c, stats, context, false, false, true);
+        }
+        return std::make_tuple(std::move(pn), std::move(conditions), std::move(names));
+    }
+
+    // what CTLMain printed, the answers to std::cout and the traces to std::cerr
+    struct output_t {
+        std::string out;
+        std::string err;
+    };
+
+    output_t run_ctl(PetriNet* pn, const std::vector<Condition_ptr>& conditions,
+            const std::vector<std::string>& names, options_t& options)
+    {
+        std::stringstream out;
+        std::stringstream err;
+        auto cout = std::cout.rdbuf(out.rdbuf());
+        auto cerr = std::cerr.rdbuf(err.rdbuf());
+        try {
+            std::vector<size_t> ids(queries.begin(), queries.end());
+            CTLMain(pn, options.ctlalgorithm, options.strategy, false, options.stubbornreduction,
+                    names, conditions, ids, options, nullptr);
+        } catch(...) {
+            std::cout.rdbuf(cout);
+            std::cerr.rdbuf(cerr);
+            throw;
+        }
+        std::cout.rdbuf(cout);
+        std::cerr.rdbuf(cerr);
+        return output_t{out.str(), err.str()};
+    }
+
+    size_t count(const std::string& text, const std::string& what)
+    {
+        size_t n = 0;
+        for(auto i = text.find(what); i != std::string::npos; i = text.find(what, i + what.size()))
+            ++n;
+        return n;
+    }
+
+    /**
+     * Solves all queries of file on one dependency graph, which is shared by
+     * the queries of a run, for both algorithms with and without threads,
+     * stubborn sets, sharing of subformulas, the successor cache and traces.
+     */
+    void check_ctl(const char* file, const std::vector<bool>& expected)
+    {
+        for(auto algorithm : {CTL::CZero, CTL::Local})
+        {
+            for(uint32_t threads : {1, 4})
+            {
+                for(bool stubborn : {false, true})
+                {
+                    for(bool batch : {false, true})
+                    {
+                        for(size_t cache : {0, 1000})
+                        {
+                            for(bool trace : {false, true})
+                            {
+                                std::cerr << file << " algorithm=" << to_underlying(algorithm)
+                                    << " threads=" << threads << std::boolalpha
+                                    << " stubborn=" << stubborn << " batch=" << batch
+                                    << " cache=" << cache << " trace=" << trace << std::endl;
+                                auto [pn, conditions, names] = load_ctl("/models/Angiogenesis-PT-01/model.pnml", file);
+                                options_t options;
+                                options.ctlalgorithm = algorithm;
+                                options.strategy = Strategy::DFS;
+                                options.threads = threads;
+                                options.stubbornreduction = stubborn;
+                                options.ctlbatch = batch;
+                                options.ctlsuccessorcache = cache;
+                                options.trace = trace ? TraceLevel::Full : TraceLevel::None;
+                                auto output = run_ctl(pn.get(), conditions, names, options);
+
+                                for(auto i : queries)
+                                {
+                                    auto answer = "FORMULA " + names[i] + (expected[i] ? " TRUE " : " FALSE ");
+                                    BOOST_TEST_INFO(names[i]);
+                                    BOOST_REQUIRE_EQUAL(count(output.out, answer), 1);
+                                }
+                                BOOST_REQUIRE_EQUAL(count(output.out, "CANNOT_COMPUTE"), 0);
+                                if(!trace)
+                                {
+                                    BOOST_REQUIRE_EQUAL(count(output.err, "<trace>"), 0);
+                                    continue;
+                                }
+                                // answers following from exhausting the graph have no witness
+                                auto traces = count(output.err, "Trace:\n<trace>");
+                                BOOST_REQUIRE_GT(traces, 0);
+                                BOOST_REQUIRE_EQUAL(count(output.err, "</trace>"), traces);
+                                BOOST_REQUIRE_EQUAL(traces + count(output.out, "No trace could be generated"), queries.size());
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DirectoryTest) {
+    BOOST_REQUIRE(getenv("TEST_FILES"));
+}
+
+// answers computed on the 110 reachable markings, deadlocks are maximal finite paths
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01CTLCardinality, * utf::timeout(300)) {
+    check_ctl("/models/Angiogenesis-PT-01/CTLCardinality.xml", {
+        true, true, true, true, true, false, true, false,
+        false, true, false, true, true, false, true, true});
+}
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01CTLFireability, * utf::timeout(300)) {
+    check_ctl("/models/Angiogenesis-PT-01/CTLFireability.xml", {
+        true, true, true, true, false, true, true, true,
+        true, true, true, true, false, false, true, true});
+}
@@ -20,6 +20,7 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 #include "utils.h"
 #include "LTL/LTLSearch.h"
@@ -29,15 +30,10 @@ using namespace PetriEngine;
 using namespace PetriEngine::Colored;
 namespace utf = boost::unit_test;
 
-BOOST_AUTO_TEST_CASE(DirectoryTest) {
-    BOOST_REQUIRE(getenv("TEST_FILES"));
-}
+namespace {
+    const std::set<size_t> qnums{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
 
-
-BOOST_AUTO_TEST_CASE(AngiogenesisPT01LTLCardinality, * utf::timeout(300)) {
-
-    std::set<size_t> qnums{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-    std::vector<Reachability::ResultPrinter::Result> expected{
+    const std::vector<Reachability::ResultPrinter::Result> cardinality{
         ResultPrinter::NotSatisfied,
         ResultPrinter::NotSatisfied,
         ResultPrinter::NotSatisfied,
@@ -55,8 +51,108 @@ BOOST_AUTO_TEST_CASE(AngiogenesisPT01LTLCardinality, * utf::timeout(300)) {
         ResultPrinter::NotSatisfied,
         ResultPrinter::NotSatisfied};
 
+    const std::vector<Reachability::ResultPrinter::Result> fireability{
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::Satisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::Satisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::NotSatisfied,
+        ResultPrinter::Satisfied};
+
+    /**
+     * Replays a trace printed by LTLSearch on the net. Every transition must
+     * be enabled where it is fired, a deadlock can only be followed by more
+     * deadlocks and the loop must return to the marking it starts in.
+     */
+    void check_trace(PetriNet& net, const std::string& trace)
+    {
+        BOOST_REQUIRE_EQUAL(trace.find("<trace>"), 0);
+        BOOST_REQUIRE_NE(trace.find("</trace>"), std::string::npos);
+        std::unique_ptr<MarkVal[]> marking(net.makeInitialMarking());
+        std::vector<MarkVal> loop;
+        const std::string transition = "transition id=\"";
+        for(auto i = trace.find('<'); i != std::string::npos; i = trace.find('<', i + 1))
+        {
+            auto tag = trace.substr(i + 1, trace.find('>', i) - i - 1);
+            if(tag == "loop/")
+            {
+                BOOST_REQUIRE(loop.empty());
+                loop.assign(marking.get(), marking.get() + net.numberOfPlaces());
+            }
+            else if(tag == "deadlock/")
+                BOOST_REQUIRE(net.deadlocked(marking.get()));
+            else if(tag.compare(0, transition.size(), transition) == 0)
+            {
+                auto name = tag.substr(transition.size(), tag.find('"', transition.size()) - transition.size());
+                auto& names = net.transitionNames();
+                auto t = std::find_if(names.begin(), names.end(), [&](auto& n) { return *n == name; }) - names.begin();
+                BOOST_TEST_INFO(name);
+                BOOST_REQUIRE_LT(t, names.size());
+                BOOST_REQUIRE(net.fireable(marking.get(), t));
+                for(auto [pre, last] = net.preset(t); pre < last; ++pre)
+                    if(!pre->inhibitor)
+                        marking[pre->place] -= pre->tokens;
+                for(auto [post, last] = net.postset(t); post < last; ++post)
+                    marking[post->place] += post->tokens;
+            }
+        }
+        // an accepting state with an invariant self loop ends the trace without a loop
+        if(!loop.empty())
+            BOOST_REQUIRE(std::equal(loop.begin(), loop.end(), marking.get()));
+    }
+
+    /**
+     * CNDFS does not use the heuristics and the partial order, only the
+     * number of threads is varied. The queries are all of the form A phi,
+     * so a trace is printed exactly for the queries that are not satisfied.
+     */
+    void check_cndfs(const char* file, const std::vector<Reachability::ResultPrinter::Result>& expected)
+    {
+        auto [pn, conditions, qstrings] = load_pn("/models/Angiogenesis-PT-01/model.pnml", file, qnums);
+        Reducer reducer(nullptr);
+        for (auto i : qnums) {
+            for (bool trace :{false, true}) {
+                for(uint32_t threads : { 1, 2, 4 })
+                {
+                    std::cerr << "Q[" << i << "] trace=" << std::boolalpha << trace
+                        << " threads=" << threads << std::endl;
+                    LTL::LTLSearch search(*pn, conditions[i], LTL::BuchiOptimization::Low, LTL::APCompression::None);
+                    auto r = search.solve(trace, 0, LTL::Algorithm::CNDFS, LTL::LTLPartialOrder::None,
+                        Strategy::DFS, LTL::LTLHeuristic::DFS, true, 0, threads);
+                    auto result = r ? ResultPrinter::Satisfied : ResultPrinter::NotSatisfied;
+                    BOOST_REQUIRE_EQUAL(expected[i], result);
+                    if(!trace)
+                        continue;
+                    std::stringstream ss;
+                    BOOST_REQUIRE_EQUAL(search.print_trace(ss, reducer), result == ResultPrinter::NotSatisfied);
+                    if(result == ResultPrinter::NotSatisfied)
+                        check_trace(*pn, ss.str());
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DirectoryTest) {
+    BOOST_REQUIRE(getenv("TEST_FILES"));
+}
+
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01LTLCardinality, * utf::timeout(300)) {
+
     auto [pn, conditions, qstrings] = load_pn("/models/Angiogenesis-PT-01/model.pnml",
         "/models/Angiogenesis-PT-01/LTLCardinality.xml", qnums);
+    const auto& expected = cardinality;
 
     for (auto i : qnums) {
         for (bool trace :{false, true}) {
@@ -70,15 +166,19 @@ BOOST_AUTO_TEST_CASE(AngiogenesisPT01LTLCardinality, * utf::timeout(300)) {
                     for(auto heur : { LTL::LTLHeuristic::DFS, LTL::LTLHeuristic::Automaton, LTL::LTLHeuristic::Distance,
                         LTL::LTLHeuristic::FireCount})
                     {
-                        std::cerr << "Q[" << i << "] trace=" << std::boolalpha << trace
-                            << " por=" << to_underlying(por) << " heur=" << to_underlying(heur) << std::endl;
-                            Strategy strategy = Strategy::HEUR;
-                        if(heur == LTL::LTLHeuristic::DFS)
-                            strategy = Strategy::HEUR;
-                        LTL::LTLSearch search(*pn, conditions[i], LTL::BuchiOptimization::Low, LTL::APCompression::None);
-                        auto r = search.solve(trace, 0, alg, por, strategy, heur, true);
-                        auto result = r ? ResultPrinter::Satisfied : ResultPrinter::NotSatisfied;
-                        BOOST_REQUIRE_EQUAL(expected[i], result);
+                        for(auto opt : { LTL::BuchiOptimization::Low, LTL::BuchiOptimization::OnTheFly})
+                        {
+                            std::cerr << "Q[" << i << "] trace=" << std::boolalpha << trace
+                                << " alg=" << to_underlying(alg) << " por=" << to_underlying(por)
+                                << " heur=" << to_underlying(heur) << " opt=" << to_underlying(opt) << std::endl;
+                                Strategy strategy = Strategy::HEUR;
+                            if(heur == LTL::LTLHeuristic::DFS)
+                                strategy = Strategy::HEUR;
+                            LTL::LTLSearch search(*pn, conditions[i], opt, LTL::APCompression::None);
+                            auto r = search.solve(trace, 0, alg, por, strategy, heur, true);
+                            auto result = r ? ResultPrinter::Satisfied : ResultPrinter::NotSatisfied;
+                            BOOST_REQUIRE_EQUAL(expected[i], result);
+                        }
                     }
                 }
             }
@@ -88,27 +188,9 @@ BOOST_AUTO_TEST_CASE(AngiogenesisPT01LTLCardinality, * utf::timeout(300)) {
 
 BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityFireability, * utf::timeout(300)) {
 
-    std::set<size_t> qnums{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-    std::vector<Reachability::ResultPrinter::Result> expected{
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::Satisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::Satisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::NotSatisfied,
-        ResultPrinter::Satisfied};
-
     auto [pn, conditions, qstrings] = load_pn("/models/Angiogenesis-PT-01/model.pnml",
         "/models/Angiogenesis-PT-01/LTLFireability.xml", qnums);
+    const auto& expected = fireability;
 
     for (auto i : qnums) {
         for (bool trace :{false, true}) {
@@ -122,20 +204,32 @@ BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityFireability, * utf::timeout(300
                         for(auto heur : { LTL::LTLHeuristic::Automaton, LTL::LTLHeuristic::Distance,
                         LTL::LTLHeuristic::FireCount, LTL::LTLHeuristic::DFS, LTL::LTLHeuristic::RDFS})
                     {
-                        std::cerr << "Q[" << i << "] trace=" << std::boolalpha << trace
-                            << " por=" << to_underlying(por) << " heur=" << to_underlying(heur) << std::endl;
-                        Strategy strategy = Strategy::HEUR;
-                        if(heur == LTL::LTLHeuristic::DFS)
-                            strategy = Strategy::DFS;
-                        if(heur == LTL::LTLHeuristic::RDFS)
-                            strategy = Strategy::RDFS;
-                        LTL::LTLSearch search(*pn, conditions[i], LTL::BuchiOptimization::Low, LTL::APCompression::None);
-                        auto r = search.solve(trace, 0, alg, por, strategy, heur, true);
-                        auto result = r ? ResultPrinter::Satisfied : ResultPrinter::NotSatisfied;
-                        BOOST_REQUIRE_EQUAL(expected[i], result);
+                        for(auto opt : { LTL::BuchiOptimization::Low, LTL::BuchiOptimization::OnTheFly})
+                        {
+                            std::cerr << "Q[" << i << "] trace=" << std::boolalpha << trace
+                                << " alg=" << to_underlying(alg) << " por=" << to_underlying(por)
+                                << " heur=" << to_underlying(heur) << " opt=" << to_underlying(opt) << std::endl;
+                            Strategy strategy = Strategy::HEUR;
+                            if(heur == LTL::LTLHeuristic::DFS)
+                                strategy = Strategy::DFS;
+                            if(heur == LTL::LTLHeuristic::RDFS)
+                                strategy = Strategy::RDFS;
+                            LTL::LTLSearch search(*pn, conditions[i], opt, LTL::APCompression::None);
+                            auto r = search.solve(trace, 0, alg, por, strategy, heur, true);
+                            auto result = r ? ResultPrinter::Satisfied : ResultPrinter::NotSatisfied;
+                            BOOST_REQUIRE_EQUAL(expected[i], result);
+                        }
                     }
                 }
             }
         }
     }
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01LTLCardinalityCNDFS, * utf::timeout(300)) {
+    check_cndfs("/models/Angiogenesis-PT-01/LTLCardinality.xml", cardinality);
+}
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01LTLFireabilityCNDFS, * utf::timeout(300)) {
+    check_cndfs("/models/Angiogenesis-PT-01/LTLFireability.xml", fireability);
+}
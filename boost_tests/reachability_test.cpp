@@ -22,19 +22,26 @@
 #include <sstream>
 
 #include "utils.h"
+#include "PetriEngine/PQL/Evaluation.h"
+#include "PetriEngine/Reachability/ReachabilitySearch.h"
+#include "PetriEngine/Structures/AlignedEncoder.h"
+#include "PetriEngine/Structures/MarkingKernels.h"
+
+#include <functional>
+#include <memory>
 
 using namespace PetriEngine;
 using namespace PetriEngine::Colored;
 namespace utf = boost::unit_test;
 
-BOOST_AUTO_TEST_CASE(DirectoryTest) {
-    BOOST_REQUIRE(getenv("TEST_FILES"));
-}
+namespace {
+    using Reachability::AbstractHandler;
+    using Reachability::StoreOptions;
 
-BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinality, * utf::timeout(60)) {
+    const std::set<size_t> cardinality_queries{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
 
-    std::set<size_t> qnums{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-    std::vector<Reachability::ResultPrinter::Result> expected{
+    // answers of the queries of Angiogenesis-PT-01/ReachabilityCardinality.xml
+    const std::vector<Reachability::ResultPrinter::Result> cardinality_expected{
         Reachability::ResultPrinter::Satisfied,
         Reachability::ResultPrinter::Satisfied,
         Reachability::ResultPrinter::Satisfied,
@@ -52,12 +59,91 @@ BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinality, * utf::timeout(60)
         Reachability::ResultPrinter::NotSatisfied,
         Reachability::ResultPrinter::NotSatisfied};
 
+    /**
+     * Shows every decided report of a search, together with the state set
+     * it was made from, to a callback before another handler answers it.
+     */
+    class InspectingHandler : public AbstractHandler {
+    public:
+        using inspect_t = std::function<void(PQL::Condition* query, Result result,
+            Structures::StateSetInterface* states, size_t lastmarking, size_t exploredStates)>;
+
+        InspectingHandler(inspect_t inspect, AbstractHandler& answer)
+        : _inspect(std::move(inspect)), _answer(answer) {}
+
+        std::pair<Result, bool> handle(size_t index, PQL::Condition* query, Result result,
+            const std::vector<uint32_t>* maxPlaceBound, size_t expandedStates, size_t exploredStates,
+            size_t discoveredStates, int maxTokens, Structures::StateSetInterface* stateset,
+            size_t lastmarking, const MarkVal* initialMarking, bool trace) override
+        {
+            if (result != Unknown)
+                _inspect(query, result, stateset, lastmarking, exploredStates);
+            return _answer.handle(index, query, result, maxPlaceBound, expandedStates, exploredStates,
+                discoveredStates, maxTokens, stateset, lastmarking, initialMarking, trace);
+        }
+
+    private:
+        inspect_t _inspect;
+        AbstractHandler& _answer;
+    };
+
+    /** Runs check on every cardinality query with every search strategy */
+    template<typename F>
+    void for_each_cardinality_search(F&& check)
+    {
+        auto [pn, conditions, qstrings] = load_pn("/models/Angiogenesis-PT-01/model.pnml",
+            "/models/Angiogenesis-PT-01/ReachabilityCardinality.xml", cardinality_queries);
+        for (auto i : cardinality_queries)
+            for (auto search :{Strategy::BFS, Strategy::DFS, Strategy::HEUR, Strategy::RDFS})
+                check(*pn, conditions[i], i, search);
+    }
+
+    AbstractHandler::Result verify(PetriNet& net, const Condition_ptr& condition, AbstractHandler& handler,
+        Strategy search, bool trace, const StoreOptions& store, bool statespace = false)
+    {
+        auto c2 = prepareForReachability(condition);
+        ReachabilitySearch strategy(net, handler, 0);
+        std::vector<Condition_ptr> vec{c2};
+        std::vector<Reachability::ResultPrinter::Result> results{Reachability::ResultPrinter::Unknown};
+        strategy.reachable(vec, results, search, false, statespace, false, trace, 0, store);
+        return results[0];
+    }
+
+    /** Fires the trace to lastmarking kept by the state set and checks that it satisfies query */
+    void check_trace(PQL::Condition* query, Structures::StateSetInterface* states, size_t lastmarking)
+    {
+        auto& net = states->net();
+        std::vector<size_t> transitions;
+        for (size_t next = lastmarking; next != 0;) {
+            auto [parent, transition] = states->getHistory(next);
+            transitions.push_back(transition);
+            next = parent;
+            BOOST_REQUIRE_LE(transitions.size(), states->discovered());
+        }
+        std::unique_ptr<MarkVal[]> marking(net.makeInitialMarking());
+        for (auto t = transitions.rbegin(); t != transitions.rend(); ++t) {
+            for (uint32_t p = 0; p < net.numberOfPlaces(); ++p) {
+                BOOST_REQUIRE_GE(marking[p], net.inArc(p, *t));
+                marking[p] += net.outArc(*t, p) - net.inArc(p, *t);
+            }
+        }
+        PQL::EvaluationContext ec(marking.get(), &net);
+        BOOST_REQUIRE(PQL::evaluate(query, ec) == PQL::Condition::RTRUE);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DirectoryTest) {
+    BOOST_REQUIRE(getenv("TEST_FILES"));
+}
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinality, * utf::timeout(60)) {
+
     auto [pn, conditions, qstrings] = load_pn("/models/Angiogenesis-PT-01/model.pnml",
-        "/models/Angiogenesis-PT-01/ReachabilityCardinality.xml", qnums);
+        "/models/Angiogenesis-PT-01/ReachabilityCardinality.xml", cardinality_queries);
 
     ResultHandler handler;
 
-    for (auto i : qnums) {
+    for (auto i : cardinality_queries) {
         for (auto search :{Strategy::BFS, Strategy::DFS, Strategy::HEUR, Strategy::RDFS}) {
             for (bool stub :{true, false}) {
                 for (bool trace :{true, false}) {
@@ -66,7 +152,7 @@ BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinality, * utf::timeout(60)
                     std::vector<Condition_ptr> vec{c2};
                     std::vector<Reachability::ResultPrinter::Result> results{Reachability::ResultPrinter::Unknown};
                     strategy.reachable(vec, results, search, stub, false, false, trace, 0);
-                    BOOST_REQUIRE_EQUAL(expected[i], results[0]);
+                    BOOST_REQUIRE_EQUAL(cardinality_expected[i], results[0]);
                 }
             }
         }
@@ -114,3 +200,157 @@ BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityFireability, * utf::timeout(60)
         }
     }
 }
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinalityMemoryLimit, * utf::timeout(60)) {
+    ResultHandler answer;
+    for_each_cardinality_search([&](PetriNet& net, const Condition_ptr& condition, size_t i, Strategy search) {
+        // small enough to spill right away, and to produce several runs per layer
+        for (size_t limit :{1, 256}) {
+            InspectingHandler handler([&](auto, auto result, auto states, auto, auto) {
+                // an exhausted search expanded the initial marking, which already exceeds one byte
+                if (limit == 1 && result == AbstractHandler::NotSatisfied)
+                    BOOST_CHECK(dynamic_cast<Structures::SpillingStateSet*>(states) != nullptr);
+            }, answer);
+            StoreOptions store;
+            store.memorylimit = limit;
+            BOOST_REQUIRE_EQUAL(cardinality_expected[i], verify(net, condition, handler, search, false, store));
+        }
+    });
+}
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinalityTraceCheckpoint, * utf::timeout(60)) {
+    ResultHandler answer;
+    for_each_cardinality_search([&](PetriNet& net, const Condition_ptr& condition, size_t i, Strategy search) {
+        for (uint32_t checkpoint :{2, 8}) {
+            InspectingHandler handler([&](auto query, auto result, auto states, auto lastmarking, auto) {
+                BOOST_CHECK(dynamic_cast<Structures::DeltaStateSet*>(states) != nullptr);
+                if (result == AbstractHandler::Satisfied)
+                    check_trace(query, states, lastmarking);
+            }, answer);
+            StoreOptions store;
+            store.tracecheckpoint = checkpoint;
+            BOOST_REQUIRE_EQUAL(cardinality_expected[i], verify(net, condition, handler, search, true, store));
+        }
+    });
+}
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinalityBitstate, * utf::timeout(60)) {
+    options_t options;
+    options.statestore = StateStore::Bitstate;
+    std::vector<std::string> names{"bitstate"};
+    Reachability::ResultPrinter printer(nullptr, &options, names);
+    for_each_cardinality_search([&](PetriNet& net, const Condition_ptr& condition, size_t i, Strategy search) {
+        // large enough that no markings of this small net collide
+        for (uint32_t hashes :{1, 3}) {
+            bool exhausted = false;
+            InspectingHandler handler([&](auto, auto result, auto, auto, auto) {
+                exhausted = result == AbstractHandler::NotSatisfied;
+            }, printer);
+            StoreOptions store;
+            store.store = StateStore::Bitstate;
+            store.bitstatesize = 24;
+            store.bitstatehashes = hashes;
+            auto result = verify(net, condition, handler, search, false, store);
+            // markings may have been pruned by collisions, so an exhausted search is no answer
+            if (exhausted)
+                BOOST_REQUIRE_EQUAL(AbstractHandler::Ignore, result);
+            else
+                BOOST_REQUIRE_EQUAL(cardinality_expected[i], result);
+        }
+    });
+}
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinalityAdaptiveEncoding, * utf::timeout(60)) {
+    ResultHandler answer;
+    for_each_cardinality_search([&](PetriNet& net, const Condition_ptr& condition, size_t i, Strategy search) {
+        for (auto trace :{false, true}) {
+            InspectingHandler handler([&](auto query, auto result, auto states, auto lastmarking, auto) {
+                if (trace && result == AbstractHandler::Satisfied)
+                    check_trace(query, states, lastmarking);
+            }, answer);
+            StoreOptions store;
+            store.adaptiveencoding = true;
+            BOOST_REQUIRE_EQUAL(cardinality_expected[i], verify(net, condition, handler, search, trace, store));
+        }
+    });
+
+    // the whole state space is stored in at most the bytes of the fixed encodings
+    auto [pn, conditions, qstrings] = load_pn("/models/Angiogenesis-PT-01/model.pnml",
+        "/models/Angiogenesis-PT-01/ReachabilityCardinality.xml", cardinality_queries);
+    size_t bytes[2] = {0, 0}, explored[2] = {0, 0};
+    for (bool adaptive :{false, true}) {
+        InspectingHandler handler([&](auto, auto, auto states, auto, auto exploredStates) {
+            bytes[adaptive] = states->memoryUsage();
+            explored[adaptive] = exploredStates;
+        }, answer);
+        StoreOptions store;
+        store.adaptiveencoding = adaptive;
+        verify(*pn, conditions[0], handler, Strategy::BFS, false, store, true);
+    }
+    BOOST_REQUIRE_EQUAL(explored[false], explored[true]);
+    BOOST_REQUIRE_GT(bytes[false], 0);
+    BOOST_REQUIRE_LE(bytes[true], bytes[false]);
+}
+
+BOOST_AUTO_TEST_CASE(AdaptiveEncodingPacksPlaces) {
+    // one large count among safe places: the fixed types spend a byte per place or per
+    // marked place, the packed encoding a bit per safe place
+    const uint32_t places = 64;
+    std::vector<uint32_t> marking(places), decoded(places);
+    marking[0] = 200;
+    for (uint32_t p = 1; p < places; ++p)
+        marking[p] = p % 2;
+    auto stats = Structures::markingStats(marking.data(), places);
+
+    size_t lengths[2];
+    for (bool adaptive :{false, true}) {
+        AlignedEncoder encoder(places, 0);
+        encoder.setAdaptive(adaptive);
+        auto type = encoder.getType(stats.sum, stats.active, stats.allsame, stats.max);
+        lengths[adaptive] = encoder.encode(marking.data(), type);
+        encoder.decode(decoded.data(), encoder.scratchpad().const_raw());
+        BOOST_REQUIRE(marking == decoded);
+    }
+    BOOST_REQUIRE_LT(lengths[true], lengths[false]);
+}
+
+BOOST_AUTO_TEST_CASE(AngiogenesisPT01ReachabilityCardinalityParallel, * utf::timeout(60)) {
+    ResultHandler answer;
+    for_each_cardinality_search([&](PetriNet& net, const Condition_ptr& condition, size_t i, Strategy search) {
+        for (bool trace :{true, false}) {
+            for (uint32_t threads :{1, 2, 4}) {
+                for (auto store :{StateStore::PTrie, StateStore::Hash}) {
+                    InspectingHandler handler([&](auto query, auto result, auto states, auto lastmarking, auto) {
+                        if (trace && result == AbstractHandler::Satisfied)
+                            check_trace(query, states, lastmarking);
+                    }, answer);
+                    StoreOptions options;
+                    options.threads = threads;
+                    options.store = store;
+                    options.hashsize = 18;
+                    BOOST_REQUIRE_EQUAL(cardinality_expected[i], verify(net, condition, handler, search, trace, options));
+                }
+            }
+        }
+    });
+
+    // the workers together find every marking exactly once
+    auto [pn, conditions, qstrings] = load_pn("/models/Angiogenesis-PT-01/model.pnml",
+        "/models/Angiogenesis-PT-01/ReachabilityCardinality.xml", cardinality_queries);
+    std::vector<size_t> explored;
+    for (uint32_t threads :{1, 2, 4}) {
+        for (auto store :{StateStore::PTrie, StateStore::Hash}) {
+            InspectingHandler handler([&](auto, auto, auto, auto, auto exploredStates) {
+                explored.push_back(exploredStates);
+            }, answer);
+            StoreOptions options;
+            options.threads = threads;
+            options.store = store;
+            options.hashsize = 18;
+            verify(*pn, conditions[0], handler, Strategy::BFS, false, options, true);
+        }
+    }
+    BOOST_REQUIRE_EQUAL(explored.size(), 6);
+    for (auto e : explored)
+        BOOST_REQUIRE_EQUAL(explored[0], e);
+}
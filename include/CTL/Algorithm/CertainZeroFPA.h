@@ -7,13 +7,19 @@
 #include "PetriEngine/Reachability/ReachabilitySearch.h"
 #include "CTL/SearchStrategy/SearchStrategy.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
 
 namespace Algorithm {
 
 class CertainZeroFPA : public FixedPointAlgorithm
 {
 public:
-    CertainZeroFPA(Strategy type) : FixedPointAlgorithm(type)
+    CertainZeroFPA(Strategy type, uint32_t threads = 1) : FixedPointAlgorithm(type), _threads(threads)
     {
     }
     virtual ~CertainZeroFPA()
@@ -25,11 +31,55 @@ protected:
     DependencyGraph::BasicDependencyGraph *graph;
     DependencyGraph::Configuration* vertex;
 
+    void processEdge(DependencyGraph::Edge* e);
     void checkEdge(DependencyGraph::Edge* e, bool only_assign = false);
-    void finalAssign(DependencyGraph::Configuration *c, DependencyGraph::Assignment a);
+    /**
+     * Drops the targets of e assigned ONE and tells whether all targets are
+     * ONE, whether one is CZERO and which is the last undecided one.
+     */
+    void scanTargets(DependencyGraph::Edge* e, bool& allOne, bool& hasCZero,
+                     DependencyGraph::Configuration*& lastUndecided);
+    // returns false if c already had a final assignment
+    bool finalAssign(DependencyGraph::Configuration *c, DependencyGraph::Assignment a);
     void finalAssign(DependencyGraph::Edge *e, DependencyGraph::Assignment a);
     void explore(DependencyGraph::Configuration *c);
+    void addSuccessors(DependencyGraph::Configuration *c, std::vector<DependencyGraph::Edge*> succs);
 
+private:
+    /**
+     * Runs the fixed point with several workers. Each worker keeps the
+     * configurations it explores in its own pending list, idle workers
+     * steal from the others. Successors are computed and their targets
+     * scanned without the lock, the waiting lists and the dependency sets
+     * are updated under it. Assignments are atomic, so they can be read
+     * without the lock.
+     */
+    bool searchParallel(size_t workers);
+    void work(size_t worker);
+    DependencyGraph::Configuration* takePending(size_t worker);
+    // moves the configurations explored under the lock to the pending list of worker
+    void handOver(size_t worker);
+    void releaseSuccessors(std::vector<DependencyGraph::Edge*>& succs);
+
+    struct pending_t {
+        std::mutex lock;
+        std::deque<DependencyGraph::Configuration*> configs;
+    };
+
+    uint32_t _threads;
+    bool _parallel = false;
+    std::vector<pending_t> _pending;
+    // explored while holding _lock, see handOver
+    std::vector<DependencyGraph::Configuration*> _explored;
+    // configurations in the pending lists
+    std::atomic<size_t> _queued{0};
+    // configurations in the pending lists or whose successors are being computed, guarded by _lock
+    size_t _outstanding = 0;
+    std::atomic<bool> _stop{false};
+    std::mutex _lock;
+    std::condition_variable _cv;
+    // held shared while successors are computed, collect takes it exclusively
+    std::shared_mutex _computing;
 };
 }
 #endif // CERTAINZEROFPA_H
@@ -5,6 +5,9 @@
 #include "CTL/SearchStrategy/SearchStrategy.h"
 #include "PetriEngine/Reachability/ReachabilitySearch.h"
 
+#include <chrono>
+#include <ostream>
+
 namespace Algorithm {
 
 class FixedPointAlgorithm {
@@ -17,7 +20,35 @@ public:
     size_t processedNegationEdges() const { return _processedNegationEdges; }
     size_t exploredConfigurations() const { return _exploredConfigurations; }
     size_t numberOfEdges() const { return _numberOfEdges; }
+
+    /**
+     * Bounds the search by wall clock seconds and by the memory of the
+     * dependency graph in bytes, 0 is unlimited. The seconds are what is
+     * left of the budget of the query. A search running out of budget
+     * stops and keeps the assignments found so far in the graph.
+     */
+    void setBudget(double seconds, size_t bytes)
+    {
+        _timeBudget = seconds;
+        _memoryBudget = bytes;
+    }
+    /** Writes a progress record to out every interval seconds of a search, 0 disables them */
+    void setProgress(double interval, std::ostream& out)
+    {
+        _progressInterval = interval;
+        _progressOut = &out;
+    }
+    // the last search ran out of budget before the initial configuration was decided
+    bool exhausted() const { return _exhausted; }
 protected:
+    // starts the clock for the budget and the progress records of a search
+    void startBudget();
+    /**
+     * Called every few edges by the searches. Writes the progress record
+     * if one is due and returns false once the budget is used up.
+     */
+    bool withinBudget(DependencyGraph::BasicDependencyGraph& graph);
+
     std::shared_ptr<SearchStrategy::SearchStrategy> strategy;
     //total number of processed edges
     size_t _processedEdges = 0;
@@ -27,6 +58,16 @@ protected:
     size_t _exploredConfigurations = 0;
     //total number of edges found when computing successors
     size_t _numberOfEdges = 0;
+    bool _exhausted = false;
+private:
+    double _timeBudget = 0;
+    size_t _memoryBudget = 0;
+    double _progressInterval = 0;
+    std::ostream* _progressOut = nullptr;
+    std::chrono::high_resolution_clock::time_point _start;
+    double _lastProgress = 0;
+    // memoryUsage walks the graph, it is measured again once this time is reached
+    double _nextMemoryCheck = 0;
 };
 }
 #endif // FIXEDPOINTALGORITHM_H
@@ -10,6 +10,10 @@
 
 #include <set>
 
+namespace PetriEngine {
+class Reducer;
+}
+
 ReturnValue CTLMain(PetriEngine::PetriNet* net,
                     CTL::CTLAlgorithmType algorithmtype,
                     Strategy strategytype,
@@ -18,6 +22,7 @@ ReturnValue CTLMain(PetriEngine::PetriNet* net,
                     const std::vector<std::string>& querynames,
                     const std::vector<std::shared_ptr<PetriEngine::PQL::Condition>>& reducedQueries,
                     const std::vector<size_t>& ids,
-                    options_t& options);
+                    options_t& options,
+                    const PetriEngine::Reducer* reducer);
 
 #endif // CTLENGINE_H
@@ -6,6 +6,7 @@
 #include "PetriEngine/options.h"
 
 
+#include <chrono>
 #include <ostream>
 #include <string>
 
@@ -18,6 +19,10 @@ struct CTLResult {
 
     PetriEngine::PQL::Condition* query;
     bool result;
+    // a search ran out of budget, result is unknown
+    bool exhausted = false;
+    // the time budget covers all the searches of the query from here
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
 
     double duration = 0;
     size_t numberOfMarkings = 0;
@@ -26,13 +31,16 @@ struct CTLResult {
     size_t processedNegationEdges = 0;
     size_t exploredConfigurations = 0;
     size_t numberOfEdges = 0;
-#ifdef VERIFYPNDIST
-    size_t numberOfRoundsComputingDistance = 0;
-    size_t numberOfTokensReceived = 0;
-    size_t numberOfRequestsReceived = 0;
-    size_t numberOfAnswersReceived = 0;
-    size_t numberOfMessagesSend = 0;
-#endif
+    size_t allocatedConfigurations = 0;
+    size_t allocatedEdges = 0;
+    size_t reclaimedConfigurations = 0;
+    size_t configurationBytes = 0;
+    size_t edgeBytes = 0;
+    size_t successorCacheHits = 0;
+    size_t successorCacheMisses = 0;
+    size_t reducedExpansions = 0;
+    // XML witness of the answer, empty if there is none
+    std::string trace;
     void print(const std::string& qname, bool statisticslevel, size_t index, options_t& options, std::ostream& out) const;
 };
 
@@ -14,8 +14,27 @@ class BasicDependencyGraph {
 
 public:
     virtual std::vector<Edge*> successors(Configuration *c) =0;
+    /** Successors computed with the scratch space of the given worker, see prepareWorkers */
+    virtual std::vector<Edge*> successors(Configuration *c, size_t worker) { return successors(c); }
+    /**
+     * Prepares for up to n workers calling successors concurrently, each
+     * with its own worker index. Returns the number of workers supported.
+     */
+    virtual size_t prepareWorkers(size_t n) { return 1; }
     virtual Configuration *initialConfiguration() =0;
     virtual void release(Edge* e) = 0;
+    /** Drops a reference to c held by an edge, e.g. when it is removed from the targets */
+    virtual void release(Configuration* c) = 0;
+    /**
+     * Reclaims the undecided configurations no longer referenced by any
+     * edge, except the initial configuration and those being explored
+     * (ZERO). Configurations with a final assignment are never reclaimed.
+     * Only to be called when no successors are being computed and the
+     * caller holds configurations through edges only.
+     */
+    virtual void collect() {}
+    /** Estimated bytes held by the graph, for memory budgets */
+    virtual size_t memoryUsage() { return 0; }
     virtual void cleanUp() =0;
 };
 
@@ -0,0 +1,126 @@
+#ifndef COMPACTVECTOR_H
+#define COMPACTVECTOR_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace DependencyGraph {
+
+/**
+ * Vector of trivially copyable values used for the target lists of edges and
+ * the dependency sets of configurations. A single element, by far the most
+ * common case for both, is stored inline; longer lists are kept in one heap
+ * array. Size and capacity are 32 bit, so the vector occupies 16 bytes.
+ * An all-zero object is a valid empty vector, as linked_bucket_t clears the
+ * memory of the edges it allocates.
+ *
+ * The heap arrays come from malloc rather than from a pool owned by the
+ * graph, unlike the edges and configurations themselves:
+ * - The vector has no room for a pool pointer, so the pool would have to
+ *   be passed to every push_back through BasicDependencyGraph.
+ * - The workers of the parallel search grow target lists concurrently.
+ *   malloc serves that from per-thread caches of size classes, whereas a
+ *   shared pool would need a lock.
+ * - Lists are freed one at a time, when configurations are reclaimed or
+ *   dependency sets shrink. realloc can extend an array in place, where
+ *   a pool of fixed size classes must copy it.
+ * Recycled edges keep their array, see clear, so steady state exploration
+ * allocates little.
+ */
+template<typename T>
+class CompactVector {
+    static_assert(std::is_trivially_copyable<T>::value, "CompactVector moves its elements with memcpy");
+public:
+    CompactVector() {}
+    CompactVector(const CompactVector&) = delete;
+    CompactVector& operator=(const CompactVector&) = delete;
+
+    ~CompactVector()
+    {
+        if(_capacity) free(_heap);
+    }
+
+    T* begin() { return _capacity ? _heap : &_inline; }
+    T* end() { return begin() + _size; }
+    const T* begin() const { return _capacity ? _heap : &_inline; }
+    const T* end() const { return begin() + _size; }
+
+    T& operator[](uint32_t i) { assert(i < _size); return begin()[i]; }
+    uint32_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    void push_back(T value)
+    {
+        if(_size == capacity()) grow();
+        begin()[_size++] = value;
+    }
+
+    T* insert(T* pos, T value)
+    {
+        uint32_t index = pos - begin();
+        assert(index <= _size);
+        if(_size == capacity()) grow();
+        T* data = begin();
+        memmove(data + index + 1, data + index, sizeof(T) * (_size - index));
+        data[index] = value;
+        ++_size;
+        return data + index;
+    }
+
+    /** Keeps the first n elements */
+    void truncate(uint32_t n)
+    {
+        assert(n <= _size);
+        _size = n;
+    }
+
+    /** Removes all elements, the storage is kept for reuse */
+    void clear() { _size = 0; }
+
+    /** Returns the heap array if the elements fit inline */
+    void shrink_to_fit()
+    {
+        if(_capacity == 0 || _size > 1) return;
+        T* heap = _heap;
+        if(_size == 1) _inline = heap[0];
+        free(heap);
+        _capacity = 0;
+    }
+
+    /** Bytes allocated outside the object */
+    size_t heapBytes() const { return sizeof(T) * _capacity; }
+
+private:
+    uint32_t capacity() const { return _capacity ? _capacity : 1; }
+
+    void grow()
+    {
+        uint32_t ncapacity = _capacity ? _capacity * 2 : 4;
+        T* data;
+        if(_capacity)
+            data = (T*)realloc(_heap, sizeof(T) * ncapacity);
+        else
+        {
+            data = (T*)malloc(sizeof(T) * ncapacity);
+            if(data && _size) data[0] = _inline;
+        }
+        if(data == nullptr) throw std::bad_alloc();
+        _heap = data;
+        _capacity = ncapacity;
+    }
+
+    union {
+        T _inline;
+        T* _heap = nullptr;
+    };
+    uint32_t _size = 0;
+    // length of the heap array, 0 while the storage is inline
+    uint32_t _capacity = 0;
+};
+
+}
+#endif // COMPACTVECTOR_H
@@ -3,11 +3,11 @@
 
 #include "Edge.h"
 
+#include <atomic>
 #include <string>
 #include <cstdio>
 #include <iostream>
 #include <vector>
-#include <forward_list>
 
 namespace DependencyGraph {
 
@@ -16,22 +16,51 @@ class Edge;
 class Configuration
 {
 public:
-    std::forward_list<Edge*> dependency_set;   
+    // sorted by address
+    CompactVector<Edge*> dependency_set;
     uint32_t nsuccs = 0;
 private:
     uint32_t distance = 0;
     void setDistance(uint32_t value) { distance = value; }
 public:
-    int8_t assignment = UNKNOWN;
+    // read without a lock by the parallel certain zero search, see CertainZeroFPA::finalAssign
+    std::atomic<int8_t> assignment{UNKNOWN};
+    // edges having the configuration as source or target, see BasicDependencyGraph::collect
+    std::atomic<uint32_t> refcnt{0};
+    // 1 + index of the successor edge justifying the final assignment, 0 if none
+    uint32_t witness = 0;
     Configuration() {}
     uint32_t getDistance() const { return distance; }
-    bool isDone() const { return assignment == ONE || assignment == CZERO; }
+    bool isDone() const
+    {
+        int8_t a = assignment;
+        return a == ONE || a == CZERO;
+    }
     void addDependency(Edge* e);
+    /** Forgets the state of a search, keeping a final assignment (ONE or CZERO) */
+    void resetSearch()
+    {
+        dependency_set.clear();
+        dependency_set.shrink_to_fit();
+        refcnt = 0;
+        distance = 0;
+        if(isDone()) return;
+        assignment = UNKNOWN;
+        nsuccs = 0;
+    }
     void setOwner(uint32_t) { }
     uint32_t getOwner() { return 0; }
     
 };
 
+inline void Edge::addTarget(Configuration* conf)
+{
+    assert(conf);
+    // successors of one configuration may be computed concurrently
+    conf->refcnt.fetch_add(1, std::memory_order_relaxed);
+    // the algorithms try the targets newest first, see OnTheFlyDG::successors
+    targets.push_back(conf);
+}
 
 }
 #endif // CONFIGURATION_H
@@ -6,7 +6,8 @@
 #include <string>
 #include <algorithm>
 #include <cassert>
-#include <forward_list>
+
+#include "CompactVector.h"
 
 namespace DependencyGraph {
 
@@ -16,17 +17,13 @@ enum Assignment {
 };
 
 class Edge {
-    typedef std::forward_list<Configuration*> container;
+    typedef CompactVector<Configuration*> container;
 public:
     Edge(){}
     Edge(Configuration &t_source) : source(&t_source) {}
 
-    void addTarget(Configuration* conf)
-    {
-        assert(conf);
-        targets.push_front(conf);
-        //++children;
-    }
+    // takes a reference to conf, defined in Configuration.h
+    inline void addTarget(Configuration* conf);
     
     container targets;    
     Configuration* source;
@@ -35,6 +32,10 @@ public:
     bool is_negated = false;
     bool handled = false;
     int32_t refcnt = 0;
+    // lower is tried first by the heuristic search
+    uint32_t weight = 0;
+    // position in the successors of the source
+    uint32_t index = 0;
     /*size_t children;
     Assignment assignment;*/
 };
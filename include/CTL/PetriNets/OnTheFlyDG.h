@@ -1,8 +1,14 @@
 #ifndef ONTHEFLYDG_H
 #define ONTHEFLYDG_H
 
-#include <functional>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <stack>
+#include <unordered_map>
 #include <ptrie/ptrie_map.h>
 
 #include "CTL/DependencyGraph/BasicDependencyGraph.h"
@@ -14,6 +20,11 @@
 #include "PetriEngine/Structures/AlignedEncoder.h"
 #include "PetriEngine/Structures/linked_bucket.h"
 #include "PetriEngine/ReducingSuccessorGenerator.h"
+#include "PetriEngine/Stubborn/ReachabilityStubbornSet.h"
+
+namespace PetriEngine {
+class Reducer;
+}
 
 namespace PetriNets {
 class OnTheFlyDG : public DependencyGraph::BasicDependencyGraph
@@ -22,17 +33,40 @@ public:
     using Condition = PetriEngine::PQL::Condition;
     using Condition_ptr = PetriEngine::PQL::Condition_ptr;
     using Marking = PetriEngine::Structures::State;
-    OnTheFlyDG(PetriEngine::PetriNet *t_net, bool partial_order);
+    /**
+     * The markings are sharded for the given number of workers, more
+     * workers can be prepared later but contend for the same shards.
+     */
+    OnTheFlyDG(PetriEngine::PetriNet *t_net, bool partial_order, size_t workers = 1);
 
     virtual ~OnTheFlyDG();
 
     //Dependency graph interface
-    virtual std::vector<DependencyGraph::Edge*> successors(DependencyGraph::Configuration *c) override;
+    virtual std::vector<DependencyGraph::Edge*> successors(DependencyGraph::Configuration *c) override
+    {
+        return successors(c, 0);
+    }
+    virtual std::vector<DependencyGraph::Edge*> successors(DependencyGraph::Configuration *c, size_t worker) override;
+    virtual size_t prepareWorkers(size_t n) override;
     virtual DependencyGraph::Configuration *initialConfiguration() override;
     virtual void cleanUp() override;
+    /**
+     * Prepares a search for query. The markings and the configurations with
+     * a final assignment are kept from earlier searches, so queries sharing
+     * subformulas share their results.
+     */
     void setQuery(Condition* query);
 
     virtual void release(DependencyGraph::Edge* e) override;
+    virtual void release(DependencyGraph::Configuration* c) override;
+    virtual void collect() override;
+    /**
+     * Bytes of the configurations and edges with their adjacency lists, and
+     * an estimate of the marking trie: the encoded markings, their
+     * configuration lists and a slot of the trie index per marking.
+     * Walks every configuration and edge.
+     */
+    virtual size_t memoryUsage() override;
 
     size_t owner(Marking& marking, Condition* cond);
     size_t owner(Marking& marking, const Condition_ptr& cond)
@@ -44,70 +78,251 @@ public:
     //stats
     size_t configurationCount() const;
     size_t markingCount() const;
+    // allocated edges, recycled edges are counted once
+    size_t edgeCount();
+    size_t allocatedConfigurationCount();
+    size_t reclaimedCount() const;
+    // memory of the configurations and edges including their adjacency lists
+    size_t configurationBytes();
+    size_t edgeBytes();
+    size_t successorCacheHits() const { return _cacheHits; }
+    size_t successorCacheMisses() const { return _cacheMisses; }
+    // expansions where the stubborn set left out some enabled transition
+    size_t reducedExpansions() const { return _reducedExpansions; }
+
+    /**
+     * Caches the successor markings of up to the given number of markings,
+     * the least recently used are evicted. 0 disables the cache.
+     * Successors computed with stubborn sets are never cached.
+     */
+    void setSuccessorCache(size_t markings);
+
+    /**
+     * Weighs the edges by the distance of their target subformula in the
+     * target marking, for the heuristic search strategy.
+     */
+    void setDistanceHeuristic(bool enable) { _distanceHeuristic = enable; }
+
+    /**
+     * Keeps the configurations justifying final assignments, so witnesses
+     * can be printed. The transitions removed by reducer are added back to
+     * the printed traces.
+     */
+    void recordWitnesses(const PetriEngine::Reducer* reducer);
+    bool recordsWitnesses() const { return _witnesses; }
+    /**
+     * Prints the witness of the answer for the current query as an XML trace,
+     * that is the successors justifying the assignment of the initial
+     * configuration. Where the query quantifies over all paths, the trace
+     * has a <branch> per successor. Returns false if there is no witness,
+     * e.g. when the answer follows from exhausting the dependency graph.
+     */
+    bool printWitness(std::ostream& out);
 
     Condition::Result initialEval();
 
 protected:
+    // scratch space of a worker computing successors
+    static constexpr size_t NO_MARKING = std::numeric_limits<size_t>::max();
+
+    // scratch space of a worker computing successors
+    struct worker_t {
+        worker_t(uint32_t places) : encoder(places, 0) {}
+        AlignedEncoder encoder;
+        Marking working_marking;
+        Marking query_marking;
+        // id of working_marking if already stored, see createMarking
+        size_t working_id = NO_MARKING;
+        std::vector<size_t> successors;
+    };
 
     //initialized from constructor
-    AlignedEncoder encoder;
     PetriEngine::PetriNet *net = nullptr;
     PetriConfig* initial_config;
-    Marking working_marking;
-    Marking query_marking;
+    // the first worker is also used outside of successors
+    std::vector<std::unique_ptr<worker_t>> _workers;
     uint32_t n_transitions = 0;
     uint32_t n_places = 0;
-    size_t _markingCount = 0;
+    std::atomic<size_t> _markingCount{0};
     size_t _configurationCount = 0;
+    // bytes of the encoded markings inserted in the tries
+    std::atomic<size_t> _markingBytes{0};
     //used after query is set
     Condition* query = nullptr;
 
+    std::vector<DependencyGraph::Edge*> computeSuccessors(DependencyGraph::Configuration *c, size_t worker);
+
+    static constexpr uint32_t NO_TRANSITION = std::numeric_limits<uint32_t>::max();
+    // a transition and the configuration justified there, either may be missing
+    struct witness_step_t {
+        uint32_t transition;
+        PetriConfig* config;
+    };
+    std::vector<witness_step_t> witnessSteps(PetriConfig* c);
+    void printWitness(PetriConfig* c, std::ostream& out, size_t depth);
+    void printTransition(uint32_t t, std::ostream& out, size_t depth) const;
+
     Condition::Result fastEval(Condition* query, Marking* unfolded);
     Condition::Result fastEval(const Condition_ptr& query, Marking* unfolded)
     {
         return fastEval(query.get(), unfolded);
     }
-    void nextStates(Marking& t_marking, Condition*,
-    std::function<void ()> pre,
-    std::function<bool (Marking&)> foreach,
-    std::function<void ()> post);
-    template<typename T>
-    void dowork(T& gen, bool& first,
-    std::function<void ()>& pre,
-    std::function<bool (Marking&)>& foreach)
+    // successors are computed with stubborn sets for ptr
+    bool reducible(Condition* ptr) const;
+    /**
+     * Computes the stubborn set of the query marking for ptr. Returns false,
+     * and the successors must be fully expanded, if an enabled stubborn
+     * transition is visible to the left side of an until.
+     */
+    bool prepareReduced(worker_t& w, Condition* ptr);
+    // transitions changing the marking of a place used by cond
+    const std::vector<bool>& visibleTransitions(Condition* cond);
+    template<typename Pre, typename Foreach, typename Post>
+    void nextStates(worker_t& w, size_t marking, Condition* ptr,
+    Pre&& pre, Foreach&& foreach, Post&& post)
     {
-        gen.prepare(&query_marking);
+        bool first = true;
+        if(reducible(ptr) && prepareReduced(w, ptr))
+        {
+            memcpy(w.working_marking.marking(), w.query_marking.marking(), n_places*sizeof(PetriEngine::MarkVal));
+            dowork(_redgen, w, first, pre, foreach);
+        }
+        else if(_successorCacheSize == 0)
+        {
+            memcpy(w.working_marking.marking(), w.query_marking.marking(), n_places*sizeof(PetriEngine::MarkVal));
+            PetriEngine::SuccessorGenerator PNGen(*net);
+            PNGen.prepare(&w.query_marking);
+            dowork(PNGen, w, first, pre, foreach);
+        }
+        else
+        {
+            cachedwork(w, marking, first, pre, foreach);
+        }
 
-        while(gen.next(working_marking)){
+        if(!first) post();
+    }
+    template<typename T, typename Pre, typename Foreach>
+    void dowork(T& gen, worker_t& w, bool& first, Pre& pre, Foreach& foreach)
+    {
+        while(gen.next(w.working_marking)){
             if(first) pre();
             first = false;
-            if(!foreach(working_marking))
+            if(!foreach(w.working_marking))
             {
                 gen.reset();
                 break;
             }
         }
     }
+    template<typename Pre, typename Foreach>
+    void cachedwork(worker_t& w, size_t marking, bool& first, Pre& pre, Foreach& foreach)
+    {
+        if(lookupSuccessors(marking, w.successors))
+        {
+            for(size_t id : w.successors)
+            {
+                decodeMarking(id, w, w.working_marking);
+                if(first) pre();
+                first = false;
+                w.working_id = id;
+                bool more = foreach(w.working_marking);
+                w.working_id = NO_MARKING;
+                if(!more) break;
+            }
+            return;
+        }
+        // all successors are stored, so the list is complete unless foreach stops early
+        w.successors.clear();
+        memcpy(w.working_marking.marking(), w.query_marking.marking(), n_places*sizeof(PetriEngine::MarkVal));
+        PetriEngine::SuccessorGenerator gen(*net);
+        gen.prepare(&w.query_marking);
+        bool complete = true;
+        while(gen.next(w.working_marking)){
+            w.working_id = createMarking(w.working_marking, w);
+            w.successors.push_back(w.working_id);
+            if(first) pre();
+            first = false;
+            bool more = foreach(w.working_marking);
+            w.working_id = NO_MARKING;
+            if(!more)
+            {
+                gen.reset();
+                complete = false;
+                break;
+            }
+        }
+        if(complete) storeSuccessors(marking, w.successors);
+    }
+    bool lookupSuccessors(size_t marking, std::vector<size_t>& successors);
+    void storeSuccessors(size_t marking, const std::vector<size_t>& successors);
+    void decodeMarking(size_t id, worker_t& w, Marking& marking);
     PetriConfig *createConfiguration(size_t marking, size_t own, Condition* query);
     PetriConfig *createConfiguration(size_t marking, size_t own, const Condition_ptr& query)
     {
         return createConfiguration(marking, own, query.get());
     }
-    size_t createMarking(Marking &marking);
+    size_t createMarking(Marking &marking, worker_t& w);
     void markingStats(const uint32_t* marking, size_t& sum, bool& allsame, uint32_t& val, uint32_t& active, uint32_t& last);
 
     DependencyGraph::Edge* newEdge(DependencyGraph::Configuration &t_source, uint32_t weight);
+    uint32_t weight(Condition* cond, PetriEngine::PQL::DistanceContext& context) const;
+    void clearTargets(DependencyGraph::Edge* e);
+    // drops the edges and the partial assignments of the previous search
+    void resetSearch();
+    void unreference(DependencyGraph::Configuration* c);
 
     std::stack<DependencyGraph::Edge*> recycle;
-    ptrie::map<ptrie::uchar, std::vector<PetriConfig*> > trie;
+    // most recently used first
+    std::list<std::pair<size_t, std::vector<size_t>>> _successorCache;
+    std::unordered_map<size_t, std::list<std::pair<size_t, std::vector<size_t>>>::iterator> _successorIndex;
+    size_t _successorCacheSize = 0;
+    bool _distanceHeuristic = false;
+    bool _witnesses = false;
+    const PetriEngine::Reducer* _reducer = nullptr;
+    size_t _cacheHits = 0;
+    size_t _cacheMisses = 0;
+    // configurations whose reference count dropped to zero since the last collect
+    std::vector<PetriConfig*> _unreferenced;
+    // reclaimed configurations, reused by createConfiguration
+    std::stack<PetriConfig*> _freeConfigs;
+    size_t _reclaimedCount = 0;
+    /**
+     * The markings and their configurations are distributed over the shards
+     * by the hash of the encoded marking. Marking ids are composed as
+     * (index in the shard << _shardbits) | shard, see ConcurrentStateSet.
+     */
+    struct shard_t {
+        std::mutex lock;
+        ptrie::map<ptrie::uchar, std::vector<PetriConfig*> > trie;
+    };
+    std::vector<shard_t> _shards;
+    size_t _shardbits = 0;
+    shard_t& shardOf(size_t marking) { return _shards[marking & (_shards.size() - 1)]; }
+    size_t indexOf(size_t marking) const { return marking >> _shardbits; }
     linked_bucket_t<DependencyGraph::Edge,1024*10>* edge_alloc = nullptr;
 
     // Problem  with linked bucket and complex constructor
     linked_bucket_t<char[sizeof(PetriConfig)], 1024*1024>* conf_alloc = nullptr;
 
+    std::shared_ptr<PetriEngine::ReachabilityStubbornSet> _stubborn;
     PetriEngine::ReducingSuccessorGenerator _redgen;
+    // visible transitions of the left sides of reduced untils
+    std::unordered_map<const Condition*, std::vector<bool>> _visible;
+    size_t _reducedExpansions = 0;
     bool _partial_order = false;
 
+    // the locks are only taken while several workers run, see prepareWorkers
+    std::unique_lock<std::mutex> guard(std::mutex& lock)
+    {
+        return _concurrent ? std::unique_lock<std::mutex>(lock) : std::unique_lock<std::mutex>();
+    }
+    // the configuration allocator, the free and unreferenced configurations
+    std::mutex _configLock;
+    // the edge allocator and the recycled edges
+    std::mutex _edgeLock;
+    std::mutex _cacheLock;
+    bool _concurrent = false;
+
 };
 
 
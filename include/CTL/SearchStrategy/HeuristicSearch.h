@@ -14,16 +14,24 @@
 
 namespace SearchStrategy {
 
-// A custom search strategy that should ensure as little overhead as possible
-// while running sequential computation.
+// Best-first search on the edge weights, i.e. the distance of the target
+// subformula in the target marking (see OnTheFlyDG::setDistanceHeuristic).
+// The waiting edges are kept in a bucket per weight, so pushing and popping
+// is constant time; within a bucket the newest edge is taken first.
 
 class HeuristicSearch : public SearchStrategy {
 
 protected:
+    // weights from here on share the last bucket
+    static constexpr uint32_t MAXBUCKET = 1023;
+
     size_t Wsize() const;
     void pushToW(DependencyGraph::Edge* edge);
     DependencyGraph::Edge* popFromW();
-    std::vector<DependencyGraph::Edge*> W;
+    std::vector<std::vector<DependencyGraph::Edge*>> W;
+    size_t _size = 0;
+    // all buckets below are empty
+    size_t _min = 0;
 };
 
 }   // end SearchStrategy
@@ -0,0 +1,113 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VERIFYPN_CNDFSMODELCHECKER_H
+#define VERIFYPN_CNDFSMODELCHECKER_H
+
+#include "LTL/Algorithm/ModelChecker.h"
+#include "LTL/Structures/ConcurrentProductStateSet.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace LTL {
+
+    /**
+     * Multi-core nested depth first search (CNDFS). Every thread runs its
+     * own nested DFS over the shared product state set, threads other than
+     * the first visit successors in a random order, so they tend to work
+     * on different parts of the state space. Blue and red states are shared
+     * between the threads, states on the blue stack are local. For details see
+     * <p>
+     *   Sami Evangelista, Alfons Laarman, Laure Petrucci & Jaco van de Pol,<br>
+     *   Improved Multi-Core Nested Depth-First Search,<br>
+     *   https://doi.org/10.1007/978-3-642-33386-6_22
+     * </p>
+     * The threads do not share the SPOT automaton, whose iterators and BDDs
+     * are not thread safe; the edges and guards are read once into a table.
+     */
+    class CNDFSModelChecker : public ModelChecker {
+    public:
+        CNDFSModelChecker(const PetriEngine::PetriNet& net, const PetriEngine::PQL::Condition_ptr &query,
+                          const Structures::BuchiAutomaton &buchi, uint32_t kbound, uint32_t threads,
+                          uint64_t seed = 0);
+
+        bool check() override;
+
+        void print_stats(std::ostream &os) const override;
+
+    private:
+        using State = LTL::Structures::ProductState;
+        static constexpr uint8_t BLUE = 1;
+        static constexpr uint8_t RED = 2;
+        static constexpr size_t NO_TRANSITION = std::numeric_limits<size_t>::max();
+
+        struct edge_t {
+            uint32_t _dest;
+            PetriEngine::PQL::Condition* _guard;
+        };
+
+        struct successor_t {
+            Structures::stateid_t _id;
+            size_t _data;
+            // the transition fired, NO_TRANSITION if the marking is deadlocked
+            size_t _transition;
+        };
+
+        struct frame_t {
+            Structures::stateid_t _id;
+            size_t _data;
+            std::vector<successor_t> _successors;
+            size_t _next = 0;
+        };
+
+        // scratch space and local colours of a thread
+        struct worker_t;
+
+        void run(size_t index);
+        void dfs_blue(worker_t& w, const successor_t& root);
+        void dfs_red(worker_t& w, std::vector<frame_t>& blue);
+        void expand(worker_t& w, frame_t& frame);
+        void report(const std::vector<frame_t>& blue, const std::vector<frame_t>* red, size_t loop_id);
+
+        bool is_accepting(Structures::stateid_t id) const
+        {
+            return _accepting[Structures::ConcurrentProductStateSet<>::get_buchi_state(id)];
+        }
+
+        Structures::ConcurrentProductStateSet<> _states;
+        uint32_t _threads;
+        uint64_t _seed;
+        std::vector<successor_t> _initial;
+        // outgoing edges per Büchi state
+        std::vector<std::vector<edge_t>> _edges;
+        // the guards of _edges as PQL conditions
+        std::vector<PetriEngine::PQL::Condition_ptr> _guards;
+        std::vector<bool> _accepting;
+        std::vector<bool> _invariant_self_loop;
+
+        std::atomic<bool> _stop = false;
+        std::atomic<size_t> _shared_explored = 0;
+        std::atomic<size_t> _shared_expanded = 0;
+        // the first thread to find a violation writes the trace
+        std::mutex _report_lock;
+    };
+}
+
+#endif //VERIFYPN_CNDFSMODELCHECKER_H
@@ -87,6 +87,8 @@ namespace LTL {
     protected:
         size_t _explored = 0;
         size_t _expanded = 0;
+        // atomic propositions evaluated by the product successor generator
+        size_t _ap_evaluations = 0;
 
         virtual void print_stats(std::ostream &os, size_t discovered, size_t max_tokens) const {
             std::cout << "STATS:\n"
@@ -29,6 +29,7 @@
 #include <ptrie/ptrie.h>
 
 #include <limits>
+#include <vector>
 
 namespace LTL {
 
@@ -53,7 +54,6 @@ namespace LTL {
             if (buchi.buchi().num_states() > 1048576) {
                 throw base_error("Cannot handle Büchi automata larger than 2^20 states");
             }
-            _chash.fill(std::numeric_limits<idx_t>::max());
         }
 
         bool check() override;
@@ -75,34 +75,102 @@ namespace LTL {
 
         using State = LTL::Structures::ProductState;
         using idx_t = size_t;
-        // 64 MB hash table
-        static constexpr idx_t _hash_sz = 16777216;
+        static constexpr idx_t NONE = std::numeric_limits<idx_t>::max();
 
         ptrie::set<idx_t,17,32,8> _store;
 
-        // rudimentary hash table of state IDs. chash[hash(state)] is the top index in cstack
-        // corresponding to state. Collisions are resolved using linked list via CEntry::next.
-        std::array<idx_t, _hash_sz> _chash;
-        static_assert(sizeof(_chash) == (1U << 27U));
+        /**
+         * Hash table from the IDs of the states on cstack to their position
+         * there, by open addressing with linear probing. Entries are removed
+         * with cstack, so the table grows with the depth of cstack only and
+         * stays small for small queries.
+         */
+        class chash_t {
+        public:
+            // position of stateid in cstack, NONE if it is not on cstack
+            template<typename C>
+            idx_t find(const C& cstack, idx_t stateid) const
+            {
+                for (size_t i = home(stateid);; i = (i + 1) & _mask) {
+                    if (_slots[i] == NONE || cstack[_slots[i]]._stateid == stateid)
+                        return _slots[i];
+                }
+            }
 
-        static inline idx_t hash(idx_t buchi_state, idx_t marking_id)
-        {
-            return (buchi_state xor marking_id) % _hash_sz;
-        }
+            // adds cstack[pos], which must not be in the table already
+            template<typename C>
+            void insert(const C& cstack, idx_t pos)
+            {
+                if ((_size + 1) * 4 > _slots.size() * 3)
+                    grow(cstack);
+                place(cstack[pos]._stateid, pos);
+                ++_size;
+            }
+
+            template<typename C>
+            void erase(const C& cstack, idx_t stateid)
+            {
+                size_t i = home(stateid);
+                while (cstack[_slots[i]]._stateid != stateid)
+                    i = (i + 1) & _mask;
+                // move later entries of the probe sequence back into the hole
+                for (size_t j = (i + 1) & _mask; _slots[j] != NONE; j = (j + 1) & _mask) {
+                    size_t k = home(cstack[_slots[j]]._stateid);
+                    if (((j - k) & _mask) >= ((j - i) & _mask)) {
+                        _slots[i] = _slots[j];
+                        i = j;
+                    }
+                }
+                _slots[i] = NONE;
+                --_size;
+            }
+
+        private:
+            size_t home(idx_t stateid) const
+            {
+                return (stateid * 0x9E3779B97F4A7C15ULL) >> _shift;
+            }
+
+            void place(idx_t stateid, idx_t pos)
+            {
+                size_t i = home(stateid);
+                while (_slots[i] != NONE)
+                    i = (i + 1) & _mask;
+                _slots[i] = pos;
+            }
+
+            template<typename C>
+            void grow(const C& cstack)
+            {
+                std::vector<idx_t> slots(_slots.size() * 2, NONE);
+                slots.swap(_slots);
+                _mask = _slots.size() - 1;
+                --_shift;
+                for (auto pos : slots)
+                    if (pos != NONE)
+                        place(cstack[pos]._stateid, pos);
+            }
+
+            std::vector<idx_t> _slots = std::vector<idx_t>(1024, NONE);
+            size_t _mask = 1023;
+            // 64 - log2 of the number of slots
+            uint32_t _shift = 54;
+            size_t _size = 0;
+        };
+        chash_t _chash;
 
         struct plain_centry_t {
             idx_t _lowlink;
             idx_t _stateid;
-            idx_t _next = std::numeric_limits<idx_t>::max();
             bool _dstack = true;
-            plain_centry_t(idx_t lowlink, idx_t stateid, idx_t next) : _lowlink(lowlink), _stateid(stateid), _next(next) {}
+            plain_centry_t(idx_t lowlink, idx_t stateid) : _lowlink(lowlink), _stateid(stateid) {}
             static constexpr bool save_trace() { return false; }
         };
 
         struct tracable_centry_t : plain_centry_t {
             idx_t _lowsource = std::numeric_limits<idx_t>::max();
             idx_t _sourcetrans;
-            tracable_centry_t(idx_t lowlink, idx_t stateid, idx_t next) : plain_centry_t(lowlink, stateid, next) {}
+            tracable_centry_t(idx_t lowlink, idx_t stateid) : plain_centry_t(lowlink, stateid) {}
             static constexpr bool save_trace() { return true; }
         };
 
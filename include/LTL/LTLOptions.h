@@ -23,7 +23,7 @@
 namespace LTL {
 
     enum class Algorithm {
-        NDFS, Tarjan, None = -1
+        NDFS, Tarjan, CNDFS, None = -1
     };
 
     enum class BuchiOutType {
@@ -46,6 +46,8 @@ namespace LTL {
     };
 
     enum class BuchiOptimization {
+        // no translation up front, states are built as the search reaches them
+        OnTheFly = 0,
         Low = 1,
         Medium = 2,
         High = 3
@@ -65,6 +67,8 @@ namespace LTL {
                 return "NDFS";
             case Algorithm::Tarjan:
                 return "TARJAN";
+            case Algorithm::CNDFS:
+                return "CNDFS";
             case Algorithm::None:
             default:
                 throw base_error("to_string: Invalid LTL Algorithm ", static_cast<int> (alg));
@@ -61,7 +61,8 @@ namespace LTL {
                 const Strategy search_strategy = Strategy::HEUR,
                 const LTLHeuristic heuristics = LTLHeuristic::Automaton,
                 const bool utilize_weak = true,
-                const uint64_t seed = 0);
+                const uint64_t seed = 0,
+                const uint32_t threads = 1);
         void print_buchi(std::ostream& out, const BuchiOutType type = BuchiOutType::Dot);
         void print_stats(std::ostream& out);
 
@@ -20,9 +20,11 @@
 
 #include "PetriEngine/Structures/StateSet.h"
 #include "LTL/Structures/ProductState.h"
+#include "LTL/Structures/CompiledGuards.h"
 
 #include <ptrie/ptrie.h>
 #include <cstdint>
+#include <vector>
 
 namespace LTL { namespace Structures {
 
@@ -35,12 +37,57 @@ namespace LTL { namespace Structures {
     using stateid_t = size_t;
     using result_t = std::tuple<bool, stateid_t, size_t>;
 
+    /**
+     * Valuations of the atomic propositions stored next to the marking ids of
+     * a product state set, so product states sharing a marking share the
+     * propositions evaluated on it, whatever their Büchi state.
+     */
+    class MarkingValuations {
+    public:
+        explicit MarkingValuations(PetriEngine::Structures::StateSet& markings)
+                : _markings(markings)
+        {
+        }
+
+        /**
+         * Marking id of the marking of state, which is added to the marking store.
+         * @return the id, or the maximal size_t if the marking exceeds the k-bound.
+         */
+        size_t marking_id(const PetriEngine::Structures::State& state)
+        {
+            return _markings.add(state).second;
+        }
+
+        /** Reads the stored valuation of a marking, an empty one if none is stored */
+        void load(size_t marking_id, ap_valuation_t& valuation) const
+        {
+            const size_t offset = marking_id * valuation.words() * 2;
+            if (offset < _words.size())
+                valuation.load(&_words[offset]);
+            else
+                valuation.clear();
+        }
+
+        void store(size_t marking_id, const ap_valuation_t& valuation)
+        {
+            const size_t stride = valuation.words() * 2;
+            if (_words.size() < (marking_id + 1) * stride)
+                _words.resize((marking_id + 1) * stride, 0);
+            valuation.store(&_words[marking_id * stride]);
+        }
+
+    private:
+        PetriEngine::Structures::StateSet& _markings;
+        // the known and value masks of each marking, indexed by marking id
+        std::vector<uint64_t> _words;
+    };
+
     template<typename stateset_type = ptrie::set<stateid_t,17,32,8>, uint8_t nbits = 20>
     class BitProductStateSet {
     public:
 
         explicit BitProductStateSet(const PetriEngine::PetriNet& net, uint32_t kbound = 0)
-                : _markings(net, kbound, net.numberOfPlaces())
+                : _markings(net, kbound, net.numberOfPlaces()), _valuations(_markings)
         {
         }
 
@@ -104,12 +151,15 @@ namespace LTL { namespace Structures {
 
         size_t max_tokens() const { return _markings.maxTokens(); }
 
+        MarkingValuations& valuations() { return _valuations; }
+
     protected:
 
         static constexpr auto BUCHI_MASK = ~(std::numeric_limits<size_t>::max() << (nbits));
         static constexpr auto MARKING_SHIFT = nbits;
 
         PetriEngine::Structures::StateSet _markings;
+        MarkingValuations _valuations;
         stateset_type _states;
         static constexpr auto _err_val = std::make_pair(false, std::numeric_limits<size_t>::max());
 
@@ -20,6 +20,7 @@
 
 #include "LTL/LTLToBuchi.h"
 #include "LTL/LTLOptions.h"
+#include "LTL/Structures/OnTheFlyBuchi.h"
 #include "PetriEngine/PQL/Evaluation.h"
 
 #include <spot/twa/twagraph.hh>
@@ -27,6 +28,7 @@
 #include <spot/twaalgos/hoa.hh>
 #include <spot/twaalgos/neverclaim.hh>
 
+#include <memory>
 #include <unordered_map>
 
 namespace LTL { namespace Structures {
@@ -34,10 +36,13 @@ namespace LTL { namespace Structures {
     private:
         spot::twa_graph_ptr _buchi = nullptr;
         std::unordered_map<int, AtomicProposition> _ap_info;
+        // set if _buchi is built on the fly, shared by all copies of the automaton
+        std::shared_ptr<OnTheFlyBuchi> _on_the_fly = nullptr;
 
     public:
-        BuchiAutomaton(spot::twa_graph_ptr buchi, std::unordered_map<int, AtomicProposition> apInfo)
-                : _buchi(std::move(buchi)), _ap_info(std::move(apInfo)) {
+        BuchiAutomaton(spot::twa_graph_ptr buchi, std::unordered_map<int, AtomicProposition> apInfo,
+                       std::shared_ptr<OnTheFlyBuchi> onTheFly = nullptr)
+                : _buchi(std::move(buchi)), _ap_info(std::move(apInfo)), _on_the_fly(std::move(onTheFly)) {
         }
 
         BuchiAutomaton() {};
@@ -60,8 +65,32 @@ namespace LTL { namespace Structures {
             return _ap_info;
         }
 
+        bool is_on_the_fly() const {
+            return _on_the_fly != nullptr;
+        }
+
+        /**
+         * Make sure the edges of a state are computed. States are only
+         * reached through edges, so the states of buchi() that exist
+         * are the initial state and the destinations of expanded states.
+         */
+        void expand(size_t state) const {
+            if (_on_the_fly) _on_the_fly->expand(state);
+        }
+
+        /** Expand the whole automaton, for users that iterate over all its states */
+        void expand_all() const {
+            if (_on_the_fly) _on_the_fly->expand_all();
+        }
+
+        bool is_accepting(size_t state) const {
+            expand(state);
+            return _buchi->state_is_accepting(state);
+        }
+
         void output_buchi(std::ostream& os, BuchiOutType type)
         {
+            expand_all();
             switch (type) {
                 case BuchiOutType::Dot:
                     spot::print_dot(os, _buchi);
@@ -0,0 +1,184 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VERIFYPN_COMPILEDGUARDS_H
+#define VERIFYPN_COMPILEDGUARDS_H
+
+#include "LTL/Structures/BuchiAutomaton.h"
+#include "PetriEngine/PQL/Evaluation.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace LTL { namespace Structures {
+
+    /**
+     * Truth values of the atomic propositions of an automaton in one
+     * marking. A proposition is evaluated the first time a guard tests it,
+     * the valuation must be cleared whenever the marking changes.
+     */
+    class ap_valuation_t {
+    public:
+        explicit ap_valuation_t(size_t naps = 0)
+        : _known((naps + 63) / 64, 0), _value((naps + 63) / 64, 0) {}
+
+        void clear() { std::fill(_known.begin(), _known.end(), 0); }
+
+        bool known(uint32_t ap) const { return (_known[ap / 64] >> (ap % 64)) & 1; }
+
+        bool value(uint32_t ap) const { return (_value[ap / 64] >> (ap % 64)) & 1; }
+
+        void set(uint32_t ap, bool value)
+        {
+            const uint64_t bit = uint64_t{1} << (ap % 64);
+            _known[ap / 64] |= bit;
+            if (value) _value[ap / 64] |= bit;
+            else _value[ap / 64] &= ~bit;
+        }
+
+        /** Number of 64-bit words of each of the known and value masks */
+        size_t words() const { return _known.size(); }
+
+        /** Reads the known mask followed by the value mask from 2*words() words */
+        void load(const uint64_t* words)
+        {
+            std::copy(words, words + _known.size(), _known.begin());
+            std::copy(words + _known.size(), words + 2 * _known.size(), _value.begin());
+        }
+
+        void store(uint64_t* words) const
+        {
+            std::copy(_known.begin(), _known.end(), words);
+            std::copy(_value.begin(), _value.end(), words + _known.size());
+        }
+
+    private:
+        std::vector<uint64_t> _known;
+        std::vector<uint64_t> _value;
+    };
+
+    /**
+     * The guards of a Büchi automaton compiled into flat decision programs.
+     * A program is the BDD of the guard laid out in an array, each node
+     * testing one atomic proposition by its dense index, so evaluating a
+     * guard neither walks BuDDy's node table nor looks up the proposition
+     * of a variable. Nodes are shared between the programs of all guards.
+     * Guards are compiled on first use; the compiled BDDs are kept alive so
+     * their ids are not reused by BuDDy.
+     */
+    class CompiledGuards {
+    public:
+        using program_t = uint32_t;
+
+        explicit CompiledGuards(const BuchiAutomaton& aut)
+        {
+            for (auto& [var, ap] : aut.ap_info()) {
+                _ap_index.emplace(var, _aps.size());
+                _aps.push_back(ap._expression);
+            }
+        }
+
+        size_t number_of_aps() const { return _aps.size(); }
+
+        /** Number of atomic propositions evaluated on a marking so far */
+        size_t evaluations() const { return _evaluations; }
+
+        ap_valuation_t make_valuation() const { return ap_valuation_t{_aps.size()}; }
+
+        program_t compile(const bdd& guard)
+        {
+            auto it = _programs.find(guard.id());
+            if (it != _programs.end())
+                return it->second.second;
+            const auto program = compile_node(guard);
+            _programs.emplace(guard.id(), std::make_pair(guard, program));
+            return program;
+        }
+
+        /**
+         * Evaluate a compiled guard, the propositions it tests are looked up
+         * in, or else evaluated into, the valuation of the marking of ctx.
+         */
+        bool evaluate(program_t program, ap_valuation_t& valuation, const PetriEngine::PQL::EvaluationContext& ctx)
+        {
+            while (program < FALSE_NODE) {
+                const auto& node = _nodes[program];
+                program = value(node._ap, valuation, ctx) ? node._high : node._low;
+            }
+            return program == TRUE_NODE;
+        }
+
+        bool evaluate(const bdd& guard, ap_valuation_t& valuation, const PetriEngine::PQL::EvaluationContext& ctx)
+        {
+            return evaluate(compile(guard), valuation, ctx);
+        }
+
+    private:
+        static constexpr program_t TRUE_NODE = std::numeric_limits<program_t>::max();
+        static constexpr program_t FALSE_NODE = TRUE_NODE - 1;
+
+        struct node_t {
+            uint32_t _ap;
+            program_t _low;
+            program_t _high;
+        };
+
+        program_t compile_node(const bdd& b)
+        {
+            // IDs 0 and 1 are false and true atoms, respectively
+            if (b == bddtrue) return TRUE_NODE;
+            if (b == bddfalse) return FALSE_NODE;
+            auto it = _node_of.find(b.id());
+            if (it != _node_of.end())
+                return it->second;
+            const auto low = compile_node(bdd_low(b));
+            const auto high = compile_node(bdd_high(b));
+            const program_t index = _nodes.size();
+            _nodes.push_back(node_t{_ap_index.at(bdd_var(b)), low, high});
+            _node_of.emplace(b.id(), index);
+            return index;
+        }
+
+        bool value(uint32_t ap, ap_valuation_t& valuation, const PetriEngine::PQL::EvaluationContext& ctx)
+        {
+            if (!valuation.known(ap)) {
+                using PetriEngine::PQL::Condition;
+                Condition::Result res = PetriEngine::PQL::evaluate(_aps[ap].get(), ctx);
+                if (res == Condition::RUNKNOWN) {
+                    assert(false);
+                    throw base_error("Unexpected unknown answer from evaluating query!");
+                }
+                valuation.set(ap, res == Condition::RTRUE);
+                ++_evaluations;
+            }
+            return valuation.value(ap);
+        }
+
+        std::vector<PetriEngine::PQL::Condition_ptr> _aps;
+        std::unordered_map<int, uint32_t> _ap_index;
+        std::vector<node_t> _nodes;
+        // BDD node id to program node, valid while _programs holds the roots
+        std::unordered_map<int, program_t> _node_of;
+        std::unordered_map<int, std::pair<bdd, program_t>> _programs;
+        size_t _evaluations = 0;
+    };
+} }
+
+#endif //VERIFYPN_COMPILEDGUARDS_H
@@ -0,0 +1,136 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VERIFYPN_CONCURRENTPRODUCTSTATESET_H
+#define VERIFYPN_CONCURRENTPRODUCTSTATESET_H
+
+#include "LTL/Structures/BitProductStateSet.h"
+
+#include <ptrie/ptrie_map.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace LTL { namespace Structures {
+
+    /**
+     * Product state set shared by several threads. The markings are split
+     * over shards by a hash of the marking, each shard being a marking
+     * store and a product store guarded by its own lock, so threads only
+     * contend when they touch the same shard.
+     * IDs are laid out as in BitProductStateSet, with the shard in the low
+     * part of the marking id. Every product state carries a byte of flags,
+     * addressed by the data_id returned from add.
+     */
+    template<uint8_t nbits = 20>
+    class ConcurrentProductStateSet {
+    public:
+        ConcurrentProductStateSet(const PetriEngine::PetriNet& net, uint32_t kbound, size_t shards)
+        : _nplaces(net.numberOfPlaces())
+        {
+            for(size_t i = 0; i < std::max<size_t>(shards, 1); ++i)
+                _shards.emplace_back(std::make_unique<shard_t>(net, kbound));
+        }
+
+        static size_t get_buchi_state(stateid_t id) { return id & BUCHI_MASK; }
+
+        /**
+         * Insert a product state into the state set.
+         * @return tripple of [is_new, ID, data_id], ID is the maximal size_t
+         *         if the marking exceeds the k-bound.
+         */
+        result_t add(const ProductState& state)
+        {
+            ++_discovered;
+            const size_t s = shard_of(state);
+            auto& shard = *_shards[s];
+            std::lock_guard<std::mutex> lock(shard._lock);
+            const auto res = shard._markings.add(state);
+            if (res.second == std::numeric_limits<size_t>::max())
+                return {false, res.second, res.second};
+            const stateid_t id = product_id(res.second * _shards.size() + s, state.get_buchi_state());
+            auto [is_new, data_id] = shard._states.insert(id);
+            return {is_new, id, data_id};
+        }
+
+        void decode(ProductState& state, stateid_t id)
+        {
+            const size_t marking = id >> nbits;
+            auto& shard = *_shards[marking % _shards.size()];
+            std::lock_guard<std::mutex> lock(shard._lock);
+            shard._markings.decode(state, marking / _shards.size());
+            state.set_buchi_state(get_buchi_state(id));
+        }
+
+        uint8_t get_flags(stateid_t id, size_t data_id)
+        {
+            auto& shard = *_shards[(id >> nbits) % _shards.size()];
+            std::lock_guard<std::mutex> lock(shard._lock);
+            return shard._states.get_data(data_id);
+        }
+
+        void set_flags(stateid_t id, size_t data_id, uint8_t flags)
+        {
+            auto& shard = *_shards[(id >> nbits) % _shards.size()];
+            std::lock_guard<std::mutex> lock(shard._lock);
+            shard._states.get_data(data_id) |= flags;
+        }
+
+        size_t discovered() const { return _discovered; }
+
+        size_t max_tokens() const
+        {
+            uint32_t tokens = 0;
+            for(auto& shard : _shards)
+                tokens = std::max(tokens, shard->_markings.maxTokens());
+            return tokens;
+        }
+
+    private:
+        struct shard_t {
+            shard_t(const PetriEngine::PetriNet& net, uint32_t kbound)
+            : _markings(net, kbound, net.numberOfPlaces()) {}
+            std::mutex _lock;
+            PetriEngine::Structures::StateSet _markings;
+            ptrie::map<stateid_t, uint8_t> _states;
+        };
+
+        static stateid_t product_id(size_t marking, size_t buchi)
+        {
+            return (buchi & BUCHI_MASK) | (marking << nbits);
+        }
+
+        static constexpr auto BUCHI_MASK = ~(std::numeric_limits<size_t>::max() << nbits);
+
+        size_t shard_of(const ProductState& state) const
+        {
+            // FNV-1a over the marking, the Büchi state is not part of the marking store
+            uint64_t hash = 14695981039346656037ULL;
+            for(size_t i = 0; i < _nplaces; ++i)
+                hash = (hash ^ state.marking()[i]) * 1099511628211ULL;
+            return (hash ^ (hash >> 32)) % _shards.size();
+        }
+
+        size_t _nplaces;
+        std::vector<std::unique_ptr<shard_t>> _shards;
+        std::atomic<size_t> _discovered = 0;
+    };
+} }
+
+#endif //VERIFYPN_CONCURRENTPRODUCTSTATESET_H
@@ -22,6 +22,7 @@
 #include "LTL/Structures/BuchiAutomaton.h"
 #include "LTL/Simplification/SpotToPQL.h"
 
+#include <memory>
 #include <vector>
 #include <spot/twa/twagraph.hh>
 #include <spot/twa/formula2bdd.hh>
@@ -51,27 +52,65 @@ namespace LTL {
 
         static std::vector<guard_info_t> from_automaton(const Structures::BuchiAutomaton &aut) {
             std::vector<guard_info_t> state_guards;
+            const auto aps = atomic_propositions(aut);
+            aut.expand_all();
+            for (decltype(aut.buchi().num_states()) state = 0; state < aut.buchi().num_states(); ++state) {
+                state_guards.push_back(from_state(aut, aps, state));
+            }
+            return state_guards;
+        }
+
+        static guard_info_t from_state(const Structures::BuchiAutomaton &aut,
+                                       const std::vector<AtomicProposition> &aps, size_t state) {
+            aut.expand(state);
+            guard_info_t info(state, aut.buchi().state_is_accepting(state));
+            for (auto &e : aut.buchi().out(state)) {
+                auto formula = spot::bdd_to_formula(e.cond, aut.buchi().get_dict());
+                if (e.dst == state) {
+                    info._retarding = guard_t{toPQL(formula, aps), e.cond, static_cast<uint32_t>(state)};
+                } else {
+                    info._progressing.push_back(guard_t{toPQL(formula, aps), e.cond, e.dst});
+                }
+            }
+            if (!info._retarding) {
+                info._retarding = guard_t{std::make_shared<PetriEngine::PQL::BooleanCondition>(false), bddfalse,
+                                          static_cast<uint32_t>(state)};
+            }
+            return info;
+        }
+
+        static std::vector<AtomicProposition> atomic_propositions(const Structures::BuchiAutomaton &aut) {
             std::vector<AtomicProposition> aps;
             aps.reserve(aut.ap_info().size());
             for(auto& [id, ap] : aut.ap_info())
                 aps.emplace_back(ap);
-            for (decltype(aut.buchi().num_states()) state = 0; state < aut.buchi().num_states(); ++state) {
-                state_guards.emplace_back(state, aut.buchi().state_is_accepting(state));
-                for (auto &e : aut.buchi().out(state)) {
-                    auto formula = spot::bdd_to_formula(e.cond, aut.buchi().get_dict());
-                    if (e.dst == state) {
-                        state_guards.back()._retarding = guard_t{toPQL(formula, aps), e.cond, state};
-                    } else {
-                        state_guards.back()._progressing.push_back(guard_t{toPQL(formula, aps), e.cond, e.dst});
-                    }
-                }
-                if (!state_guards.back()._retarding) {
-                    state_guards.back()._retarding = guard_t{std::make_shared<PetriEngine::PQL::BooleanCondition>(false), bddfalse, state};
-                }
-            }
-            return state_guards;
+            return aps;
         }
     };
+
+    /**
+     * The guard_info_t of each Büchi state, computed the first time the
+     * state is looked up, so an automaton built on the fly is only
+     * expanded in the states the search visits.
+     */
+    class guard_info_cache_t {
+    public:
+        explicit guard_info_cache_t(const Structures::BuchiAutomaton &aut)
+        : _aut(aut), _aps(guard_info_t::atomic_propositions(aut)) {}
+
+        const guard_info_t& operator[](size_t state) {
+            if (state >= _infos.size())
+                _infos.resize(state + 1);
+            if (!_infos[state])
+                _infos[state] = std::make_unique<guard_info_t>(guard_info_t::from_state(_aut, _aps, state));
+            return *_infos[state];
+        }
+
+    private:
+        const Structures::BuchiAutomaton &_aut;
+        std::vector<AtomicProposition> _aps;
+        std::vector<std::unique_ptr<guard_info_t>> _infos;
+    };
 }
 
 #endif //VERIFYPN_GUARDINFO_H
@@ -0,0 +1,140 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VERIFYPN_ONTHEFLYBUCHI_H
+#define VERIFYPN_ONTHEFLYBUCHI_H
+
+#include "utils/errors.h"
+
+#include <spot/twa/twagraph.hh>
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace LTL { namespace Structures {
+
+    /**
+     * Builds a state-based Büchi automaton from an on-the-fly automaton of SPOT
+     * (such as the TGBA view of ltl_to_taa) one state at a time. The states
+     * and edges are written into an ordinary twa_graph, so the rest of the
+     * LTL engine reads it as any other automaton, but the edges of a state
+     * only exist once the state is expanded.
+     * The generalized acceptance of the source is degeneralized with a level
+     * counter: a state of the result is a source state and the number of
+     * acceptance sets seen in order since the last accepting state, and it is
+     * accepting when all sets have been seen.
+     */
+    class OnTheFlyBuchi {
+    public:
+        // the product state sets reserve 20 bits for the Büchi state
+        static constexpr size_t MAX_STATES = 1048576;
+
+        OnTheFlyBuchi(spot::const_twa_ptr source, spot::twa_graph_ptr target)
+        : _source(std::move(source)), _target(std::move(target)), _nsets(_source->acc().num_sets())
+        {
+            _target->copy_ap_of(_source);
+            _target->set_buchi();
+            _target->prop_state_acc(true);
+            _target->set_init_state(number(_source->get_init_state(), 0));
+        }
+
+        OnTheFlyBuchi(const OnTheFlyBuchi&) = delete;
+        OnTheFlyBuchi& operator=(const OnTheFlyBuchi&) = delete;
+
+        ~OnTheFlyBuchi()
+        {
+            for (auto& [s, level] : _origin)
+                s->destroy();
+        }
+
+        bool expanded(size_t state) const { return state < _expanded.size() && _expanded[state]; }
+
+        /** Compute the outgoing edges of state, if not already done */
+        void expand(size_t state)
+        {
+            if (expanded(state))
+                return;
+            _expanded[state] = true;
+            const auto [source, level] = _origin[state];
+            const bool accepting = level == _nsets;
+            // acceptance sets are counted again after an accepting state
+            const unsigned from = accepting ? 0 : level;
+            auto* it = _source->succ_iter(source);
+            for (bool more = it->first(); more; more = it->next()) {
+                auto marks = it->acc();
+                unsigned to = from;
+                while (to < _nsets && marks.has(to))
+                    ++to;
+                const unsigned dst = number(it->dst(), to);
+                _target->new_edge(state, dst, it->cond(),
+                                  accepting ? spot::acc_cond::mark_t({0}) : spot::acc_cond::mark_t({}));
+            }
+            _source->release_iter(it);
+        }
+
+        /** Expand every reachable state, for users needing the whole automaton */
+        void expand_all()
+        {
+            for (size_t state = 0; state < _origin.size(); ++state)
+                expand(state);
+        }
+
+    private:
+        struct key_hash {
+            size_t operator()(const std::pair<const spot::state*, unsigned>& key) const
+            {
+                return key.first->hash() * 0x9E3779B97F4A7C15ULL + key.second;
+            }
+        };
+
+        struct key_equal {
+            bool operator()(const std::pair<const spot::state*, unsigned>& a,
+                            const std::pair<const spot::state*, unsigned>& b) const
+            {
+                return a.second == b.second && a.first->compare(b.first) == 0;
+            }
+        };
+
+        // number of the state (s, level) of the result, takes ownership of s
+        unsigned number(const spot::state* s, unsigned level)
+        {
+            auto it = _numbers.find({s, level});
+            if (it != _numbers.end()) {
+                s->destroy();
+                return it->second;
+            }
+            if (_origin.size() >= MAX_STATES)
+                throw base_error("Cannot handle Büchi automata larger than 2^20 states");
+            const unsigned n = _target->new_state();
+            _origin.emplace_back(s, level);
+            _expanded.push_back(false);
+            _numbers.emplace(std::make_pair(s, level), n);
+            return n;
+        }
+
+        spot::const_twa_ptr _source;
+        spot::twa_graph_ptr _target;
+        unsigned _nsets;
+        // the source state and level of each state of _target
+        std::vector<std::pair<const spot::state*, unsigned>> _origin;
+        std::vector<bool> _expanded;
+        std::unordered_map<std::pair<const spot::state*, unsigned>, unsigned, key_hash, key_equal> _numbers;
+    };
+} }
+
+#endif //VERIFYPN_ONTHEFLYBUCHI_H
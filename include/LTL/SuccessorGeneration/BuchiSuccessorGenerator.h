@@ -41,6 +41,7 @@ namespace LTL {
 
         void prepare(size_t state)
         {
+            _aut.expand(state);
             auto curstate = _aut.buchi().state_from_number(state);
             _succ = _succ_iter{_aut.buchi().succ_iter(curstate), SuccIterDeleter{&_aut}};
             _succ->first();
@@ -61,7 +62,7 @@ namespace LTL {
 
         [[nodiscard]] bool is_accepting(size_t state) const
         {
-            return _aut.buchi().state_is_accepting(state);
+            return _aut.is_accepting(state);
         }
 
         [[nodiscard]] size_t initial_state_number() const
@@ -82,6 +83,9 @@ namespace LTL {
         size_t buchi_states() const { return _aut.buchi().num_states(); }
 
         bool has_invariant_self_loop(size_t state) {
+            _aut.expand(state);
+            if (state >= _self_loops.size())
+                _self_loops.resize(_aut.buchi().num_states(), InvariantSelfLoop::UNKNOWN);
             if (_self_loops[state] != InvariantSelfLoop::UNKNOWN)
                 return _self_loops[state] == InvariantSelfLoop::TRUE;
             auto it = std::unique_ptr<spot::twa_succ_iterator>{
@@ -26,6 +26,8 @@
 #include "LTL/LTLToBuchi.h"
 #include "LTL/Stubborn/VisibleLTLStubbornSet.h"
 #include "LTL/Simplification/SpotToPQL.h"
+#include "LTL/Structures/BitProductStateSet.h"
+#include "LTL/Structures/CompiledGuards.h"
 #include "LTL/Structures/GuardInfo.h"
 #include "LTL/SuccessorGeneration/SpoolingSuccessorGenerator.h"
 #include "LTL/SuccessorGeneration/ResumingSuccessorGenerator.h"
@@ -33,6 +35,8 @@
 #include <spot/twa/formula2bdd.hh>
 #include <spot/tl/formula.hh>
 
+#include <algorithm>
+
 namespace LTL {
 
     template<class SuccessorGen>
@@ -46,7 +50,8 @@ namespace LTL {
                                   const Structures::BuchiAutomaton& buchi,
                                   SuccessorGen& successorGen)
                 : _successor_generator(successorGen), _net(net),
-                  _buchi_succ_gen(buchi)
+                  _buchi_succ_gen(buchi), _guards(buchi), _valuation(_guards.make_valuation()),
+                  _scratch_valuation(_guards.make_valuation()), _valuation_marking(net.numberOfPlaces())
         {
 
         }
@@ -65,6 +70,9 @@ namespace LTL {
                     std::copy(_successor_generator->getParent(), _successor_generator->getParent() + state._buchi_state_idx + 1,
                               state.marking());
                 }
+                new_marking(state);
+            } else {
+                resume_marking(state);
             }
             if (next_buchi_succ(state)) {
                 return true;
@@ -73,6 +81,7 @@ namespace LTL {
                 // Try next marking(s) and see if we find a successor.
             else {
                 while (_successor_generator->next(state)) {
+                    new_marking(state);
                     // reset buchi successors
                     _buchi_succ_gen.prepare(_buchi_parent);
                     if (next_buchi_succ(state)) {
@@ -83,6 +92,17 @@ namespace LTL {
             }
         }
 
+        /**
+         * Share the valuations of the atomic propositions between product states
+         * with the same marking, through the marking ids of a product state set.
+         */
+        void set_valuation_cache(Structures::MarkingValuations* cache)
+        {
+            _valuation_cache = _guards.number_of_aps() > 0 ? cache : nullptr;
+        }
+
+        size_t ap_evaluations() const { return _guards.evaluations(); }
+
         bool is_accepting(size_t b_state)
         {
             return _buchi_succ_gen.is_accepting(b_state);
@@ -103,6 +123,7 @@ namespace LTL {
             state.setMarking(buf, _net.numberOfPlaces());
             //state.setBuchiState(initial_buchi_state());
             _buchi_succ_gen.prepare(state.get_buchi_state());
+            new_marking(state);
             while (next_buchi_succ(state)) {
                 states.emplace_back(&_buchi_succ_gen.automaton());
                 states.back().setMarking(new PetriEngine::MarkVal[_net.numberOfPlaces() + 1], _net.numberOfPlaces());
@@ -159,6 +180,9 @@ namespace LTL {
                     std::copy(_successor_generator.getParent(), _successor_generator.getParent() + state._buchi_state_idx + 1,
                               state.marking());
                 }
+                new_marking(state);
+            } else {
+                resume_marking(state);
             }
             if (next_buchi_succ(state)) {
                 //_successor_generator->getSuccInfo(sucinfo);
@@ -169,6 +193,7 @@ namespace LTL {
                 // Try next marking(s) and see if we find a successor.
             else {
                 while (_successor_generator.next(state, sucinfo)) {
+                    new_marking(state);
                     // reset buchi successors
                     _buchi_succ_gen.prepare(_buchi_parent);
                     if (next_buchi_succ(state)) {
@@ -255,28 +280,70 @@ namespace LTL {
         size_t _buchi_parent;
         bool _fresh_marking = true;
         std::vector<guard_info_t> _stateToGuards;
+        Structures::CompiledGuards _guards;
+        // propositions of the marking of the successors being generated
+        Structures::ap_valuation_t _valuation;
+        Structures::ap_valuation_t _scratch_valuation;
+        // the marking _valuation belongs to
+        std::vector<PetriEngine::MarkVal> _valuation_marking;
+        Structures::MarkingValuations* _valuation_cache = nullptr;
+        size_t _valuation_id = std::numeric_limits<size_t>::max();
+
         /**
          * Evaluate binary decision diagram (BDD) representation of transition guard in given state.
          */
         bool guard_valid(const PetriEngine::Structures::State &state, bdd bdd)
         {
             PetriEngine::PQL::EvaluationContext ctx{state.marking(), &_net};
-            return _buchi_succ_gen.automaton().guard_valid(ctx, bdd);
+            _scratch_valuation.clear();
+            return _guards.evaluate(bdd, _scratch_valuation, ctx);
         }
 
 
     private:
 
+        /**
+         * The marking of state is a new successor marking, the propositions are
+         * evaluated again on demand.
+         */
+        void new_marking(const LTL::Structures::ProductState &state)
+        {
+            std::copy(state.marking(), state.marking() + _net.numberOfPlaces(), _valuation_marking.begin());
+            if (_valuation_cache != nullptr) {
+                _valuation_id = _valuation_cache->marking_id(state);
+                if (_valuation_id != std::numeric_limits<size_t>::max()) {
+                    _valuation_cache->load(_valuation_id, _valuation);
+                    return;
+                }
+            }
+            _valuation.clear();
+        }
+
+        /**
+         * Iteration resumes within the Büchi successors of the marking of state,
+         * which is usually the marking of the previous call to next.
+         */
+        void resume_marking(const LTL::Structures::ProductState &state)
+        {
+            if (!std::equal(_valuation_marking.begin(), _valuation_marking.end(), state.marking()))
+                new_marking(state);
+        }
+
         bool next_buchi_succ(LTL::Structures::ProductState &state)
         {
+            PetriEngine::PQL::EvaluationContext ctx{state.marking(), &_net};
             size_t tmp;
+            bool found = false;
             while (_buchi_succ_gen.next(tmp, _cond)) {
-                if (guard_valid(state, _cond)) {
+                if (_guards.evaluate(_cond, _valuation, ctx)) {
                     state.set_buchi_state(tmp);
-                    return true;
+                    found = true;
+                    break;
                 }
             }
-            return false;
+            if (_valuation_cache != nullptr && _valuation_id != std::numeric_limits<size_t>::max())
+                _valuation_cache->store(_valuation_id, _valuation);
+            return found;
         }
     };
 
@@ -40,6 +40,7 @@ namespace LTL {
 
         void calc_safe_reach_states(const Structures::BuchiAutomaton &buchi) {
             assert(_reach_states.empty());
+            buchi.expand_all();
             std::vector<AtomicProposition> aps;
             aps.reserve(buchi.ap_info().size());
             for(auto& [id, ap] : buchi.ap_info())
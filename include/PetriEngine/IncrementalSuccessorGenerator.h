@@ -0,0 +1,61 @@
+#ifndef PETRIENGINE_INCREMENTALSUCCESSORGENERATOR_H_
+#define PETRIENGINE_INCREMENTALSUCCESSORGENERATOR_H_
+
+#include "SuccessorGenerator.h"
+#include "Structures/State.h"
+#include "PQL/PQL.h"
+
+#include <memory>
+#include <vector>
+
+namespace PetriEngine {
+
+    /**
+     * Successor generator keeping the set of enabled transitions of the
+     * prepared state. When a state is prepared as the successor of a state
+     * with a known enabled set, only the transitions reading a place touched
+     * by the fired transition are re-evaluated.
+     * Successors are generated in the same order as by SuccessorGenerator.
+     */
+    class IncrementalSuccessorGenerator : public SuccessorGenerator {
+    public:
+        IncrementalSuccessorGenerator(const PetriNet &net);
+
+        IncrementalSuccessorGenerator(const PetriNet &net, std::vector<std::shared_ptr<PQL::Condition> > &queries);
+
+        using SuccessorGenerator::prepare;
+
+        bool prepare(const Structures::State *state) override;
+
+        /**
+         * Prepares state, which is reached from a state with the (sorted)
+         * enabled transitions parent by firing fired.
+         */
+        bool prepare(const Structures::State *state, const std::vector<uint32_t>& parent, uint32_t fired);
+
+        /** Prepares state, which is reached by firing fired from the state prepared last */
+        bool prepareSuccessor(const Structures::State *state, uint32_t fired);
+
+        bool next(Structures::State &write) override;
+
+        /** Enabled transitions of the prepared state, in increasing order */
+        const std::vector<uint32_t>& enabled() const { return _enabled; }
+
+    private:
+        void _update(const std::vector<uint32_t>& parent, uint32_t fired, std::vector<uint32_t>& result);
+
+        // transitions with an arc (incl. inhibitor arcs) from a place, indexed by _consumerPtrs
+        std::vector<uint32_t> _consumerPtrs;
+        std::vector<uint32_t> _consumers;
+
+        std::vector<uint32_t> _enabled;
+        std::vector<uint32_t> _scratch;
+        size_t _index = 0;
+
+        // marks the transitions re-evaluated for the current state
+        std::vector<uint32_t> _stamps;
+        uint32_t _stamp = 0;
+    };
+}
+
+#endif /* PETRIENGINE_INCREMENTALSUCCESSORGENERATOR_H_ */
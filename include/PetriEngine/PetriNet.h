@@ -148,6 +148,7 @@ namespace PetriEngine {
         friend class Reducer;
         friend class SuccessorGenerator;
         friend class ReducingSuccessorGenerator;
+        friend class IncrementalSuccessorGenerator;
         friend class STSolver;
         friend class StubbornSet;
     };
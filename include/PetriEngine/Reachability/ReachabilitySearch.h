@@ -23,16 +23,32 @@
 #include "../Structures/State.h"
 #include "ReachabilityResult.h"
 #include "../PQL/PQL.h"
+#include "../PQL/Evaluation.h"
+#include "../PQL/PredicateCheckers.h"
 #include "../PetriNet.h"
 #include "../Structures/StateSet.h"
+#include "../Structures/ConcurrentStateSet.h"
+#include "../Structures/HashStateSet.h"
+#include "../Structures/DeltaStateSet.h"
+#include "../Structures/BitStateSet.h"
+#include "../Structures/SpillingStateSet.h"
 #include "../Structures/Queue.h"
+#include "../Structures/StealingQueue.h"
 #include "../SuccessorGenerator.h"
 #include "../ReducingSuccessorGenerator.h"
+#include "../IncrementalSuccessorGenerator.h"
 #include "PetriEngine/Stubborn/ReachabilityStubbornSet.h"
 #include "PetriEngine/Stubborn/ReachabilityStubbornSet.h"
 #include "PetriEngine/options.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 
@@ -40,6 +56,23 @@
 namespace PetriEngine {
     namespace Reachability {
 
+        /** How a search stores its markings, and the limits on the store */
+        struct StoreOptions {
+            // workers sharing the store
+            uint32_t threads = 1;
+            StateStore store = StateStore::PTrie;
+            // log2 of the number of slots of the hash store
+            uint32_t hashsize = 22;
+            // in bytes, 0 if unbounded
+            size_t memorylimit = 0;
+            // every how many steps a traced marking is stored in full
+            uint32_t tracecheckpoint = 1;
+            // log2 of the number of bits and the number of hashes of the bitstate store
+            uint32_t bitstatesize = 30;
+            uint32_t bitstatehashes = 3;
+            bool adaptiveencoding = false;
+        };
+
         /** Implements reachability check in a BFS manner using a hash table */
         class ReachabilitySearch {
         public:
@@ -61,7 +94,8 @@ namespace PetriEngine {
                     bool statespacesearch,
                     bool printstats,
                     bool keep_trace,
-                    size_t seed);
+                    size_t seed,
+                    const StoreOptions& storeoptions = StoreOptions{});
         private:
             struct searchstate_t {
                 size_t expandedStates = 0;
@@ -78,14 +112,42 @@ namespace PetriEngine {
                 bool usequeries,
                 bool printstats,
                 size_t seed);
+
+            /** Moves the visited markings and the queue of an in-memory search to disk */
+            template<typename Q, typename W>
+            std::unique_ptr<Structures::SpillingStateSet> spill(std::unique_ptr<W>& states, Q& queue, searchstate_t& ss);
+
+            /** Continues a search with the state space on disk, layer by layer */
+            template<typename G>
+            bool tryReachOnDisk(
+                std::vector<std::shared_ptr<PQL::Condition > >& queries,
+                std::vector<ResultPrinter::Result>& results,
+                bool printstats,
+                searchstate_t& ss,
+                G& generator,
+                std::unique_ptr<Structures::SpillingStateSet> states);
+
+            /** Explores the state space using one or more workers sharing a ParallelStateSetInterface */
+            template<typename Q, typename W, typename G>
+            bool tryReachParallel(
+                std::vector<std::shared_ptr<PQL::Condition > >& queries,
+                std::vector<ResultPrinter::Result>& results,
+                bool usequeries,
+                bool printstats,
+                bool keep_trace,
+                size_t seed);
             void printStats(searchstate_t& s, Structures::StateSetInterface*);
             bool checkQueries(  std::vector<std::shared_ptr<PQL::Condition > >&,
                                     std::vector<ResultPrinter::Result>&,
                                     Structures::State&, searchstate_t&, Structures::StateSetInterface*);
             std::pair<ResultPrinter::Result,bool> doCallback(std::shared_ptr<PQL::Condition>& query, size_t i, ResultPrinter::Result r, searchstate_t &ss, Structures::StateSetInterface *states);
 
+            // serializes callbacks and the evaluation of bound queries between workers
+            std::mutex _queryLock;
+
             PetriNet& _net;
             int _kbound;
+            StoreOptions _store;
             size_t _satisfyingMarking = 0;
             Structures::State _initial;
             AbstractHandler& _callback;
@@ -102,6 +164,14 @@ namespace PetriEngine {
             return ReducingSuccessorGenerator{net, stubset};
         }
 
+        template <typename W>
+        inline W _makeStateSet(PetriNet &net, uint32_t kbound, bool keep_trace, const StoreOptions& store) {
+            if constexpr (std::is_same<W, Structures::HashStateSet>::value)
+                return W{net, kbound, store.threads, keep_trace, store.hashsize};
+            else
+                return W{net, kbound, store.threads, keep_trace};
+        }
+
         template<typename Q, typename W, typename G>
         bool ReachabilitySearch::tryReach(   std::vector<std::shared_ptr<PQL::Condition> >& queries,
                                         std::vector<ResultPrinter::Result>& results, bool usequeries,
@@ -123,10 +193,17 @@ namespace PetriEngine {
             state.setMarking(_net.makeInitialMarking());
             working.setMarking(_net.makeInitialMarking());
 
-            W states(_net, _kbound);    // stateset
+            std::unique_ptr<W> states;    // stateset
+            if constexpr (std::is_same<W, Structures::DeltaStateSet>::value)
+                states = std::make_unique<W>(_net, _kbound, _store.tracecheckpoint);
+            else if constexpr (std::is_same<W, Structures::BitStateSet>::value)
+                states = std::make_unique<W>(_net, _kbound, _store.bitstatesize, _store.bitstatehashes);
+            else
+                states = std::make_unique<W>(_net, _kbound);
+            states->setAdaptiveEncoding(_store.adaptiveencoding);
             Q queue(seed);           // working queue
             G generator = _makeSucGen<G>(_net, queries); // successor generator
-            auto r = states.add(state);
+            auto r = states->add(state);
             // this can fail due to reductions; we push tokens around and violate K
             if(r.first){
                 // add initial to states, check queries on initial state
@@ -134,9 +211,9 @@ namespace PetriEngine {
                 // check initial marking
                 if(ss.usequeries)
                 {
-                    if(checkQueries(queries, results, working, ss, &states))
+                    if(checkQueries(queries, results, working, ss, states.get()))
                     {
-                        if(printstats) printStats(ss, &states);
+                        if(printstats) printStats(ss, states.get());
                             return true;
                     }
                 }
@@ -146,30 +223,278 @@ namespace PetriEngine {
                     queue.push(r.second, &dc, queries[ss.heurquery].get());
                 }
 
+                // successors of the state expanded last, with the transition leading to them
+                std::vector<std::pair<size_t, uint32_t>> children;
+
                 // Search!
                 for(auto nid = queue.pop(); nid != Structures::Queue::EMPTY; nid = queue.pop()) {
-                    states.decode(state, nid);
-                    generator.prepare(&state);
+                    states->decode(state, nid);
+                    if constexpr (std::is_same<G, IncrementalSuccessorGenerator>::value) {
+                        // depth-first orders mostly pop a child of the state just expanded,
+                        // whose enabled transitions the generator still knows
+                        auto child = std::find_if(children.rbegin(), children.rend(),
+                            [nid](auto& c) { return c.first == nid; });
+                        if(child != children.rend())
+                            generator.prepareSuccessor(&state, child->second);
+                        else
+                            generator.prepare(&state);
+                        children.clear();
+                    }
+                    else generator.prepare(&state);
 
                     while(generator.next(working)){
                         ss.enabledTransitionsCount[generator.fired()]++;
-                        auto res = states.add(working);
+                        auto res = states->add(working);
                         if (res.first) {
                             {
                                 PQL::DistanceContext dc(&_net, working.marking());
                                 queue.push(res.second, &dc, queries[ss.heurquery].get());
                             }
-                            states.setHistory(res.second, generator.fired());
+                            states->setHistory(res.second, generator.fired());
+                            if constexpr (std::is_same<G, IncrementalSuccessorGenerator>::value)
+                                children.emplace_back(res.second, generator.fired());
                             _satisfyingMarking = res.second;
                             ss.exploredStates++;
-                            if (checkQueries(queries, results, working, ss, &states)) {
-                                if(printstats) printStats(ss, &states);
+                            if (checkQueries(queries, results, working, ss, states.get())) {
+                                if(printstats) printStats(ss, states.get());
                                 return true;
                             }
                         }
                     }
                     ss.expandedStates++;
+
+                    if(_store.memorylimit != 0 && states->memoryUsage() >= _store.memorylimit)
+                        return tryReachOnDisk(queries, results, printstats, ss, generator, spill(states, queue, ss));
+                }
+            }
+
+            // no more successors, print last results
+            for(size_t i= 0; i < queries.size(); ++i)
+            {
+                if(results[i] == ResultPrinter::Unknown)
+                {
+                    results[i] = doCallback(queries[i], i, ResultPrinter::NotSatisfied, ss, states.get()).first;
+                }
+            }
+
+            if(printstats) printStats(ss, states.get());
+            return false;
+        }
+
+        template<typename Q, typename W>
+        std::unique_ptr<Structures::SpillingStateSet> ReachabilitySearch::spill(std::unique_ptr<W>& states, Q& queue, searchstate_t& ss)
+        {
+            auto spilled = std::make_unique<Structures::SpillingStateSet>(_net, _kbound, _store.memorylimit);
+            spilled->inherit(*states);
+            Structures::State state;
+            state.setMarking(_net.makeInitialMarking());
+            // ids of the in-memory set are consecutive, one for each explored state
+            for(size_t id = 0; id < ss.exploredStates; ++id)
+            {
+                states->decode(state, id);
+                spilled->addVisited(state);
+            }
+            for(auto nid = queue.pop(); nid != Structures::Queue::EMPTY; nid = queue.pop())
+            {
+                states->decode(state, nid);
+                spilled->addFrontier(state);
+            }
+            states.reset();
+            spilled->seal();
+            return spilled;
+        }
+
+        template<typename G>
+        bool ReachabilitySearch::tryReachOnDisk(std::vector<std::shared_ptr<PQL::Condition> >& queries,
+                                        std::vector<ResultPrinter::Result>& results, bool printstats,
+                                        searchstate_t& ss, G& generator,
+                                        std::unique_ptr<Structures::SpillingStateSet> states)
+        {
+            if(printstats)
+                std::cout << "Memory limit reached after " << ss.exploredStates
+                          << " states, continuing with the state space on disk" << std::endl;
+
+            Structures::State state;
+            Structures::State working;
+            state.setMarking(_net.makeInitialMarking());
+            working.setMarking(_net.makeInitialMarking());
+
+            // queries are checked once a marking is known to be new, i.e. when its layer is merged
+            std::function<bool(Structures::State&)> onNew = [&](Structures::State& marking) {
+                ss.exploredStates++;
+                return checkQueries(queries, results, marking, ss, states.get());
+            };
+
+            while(!states->frontierEmpty())
+            {
+                while(states->nextFrontier(state))
+                {
+                    generator.prepare(&state);
+                    while(generator.next(working)){
+                        ss.enabledTransitionsCount[generator.fired()]++;
+                        states->add(working);
+                    }
+                    ss.expandedStates++;
                 }
+                if(states->nextLayer(working, onNew))
+                {
+                    if(printstats) printStats(ss, states.get());
+                    return true;
+                }
+            }
+
+            // no more successors, print last results
+            for(size_t i= 0; i < queries.size(); ++i)
+            {
+                if(results[i] == ResultPrinter::Unknown)
+                {
+                    results[i] = doCallback(queries[i], i, ResultPrinter::NotSatisfied, ss, states.get()).first;
+                }
+            }
+
+            if(printstats) printStats(ss, states.get());
+            return false;
+        }
+
+        template<typename Q, typename W, typename G>
+        bool ReachabilitySearch::tryReachParallel(std::vector<std::shared_ptr<PQL::Condition> >& queries,
+                                        std::vector<ResultPrinter::Result>& results, bool usequeries,
+                                        bool printstats, bool keep_trace, size_t seed)
+        {
+            const uint32_t threads = _store.threads;
+            // set up state
+            searchstate_t ss;
+            ss.enabledTransitionsCount.resize(_net.numberOfTransitions(), 0);
+            ss.expandedStates = 0;
+            ss.exploredStates = 1;
+            ss.heurquery = queries.size() >= 2 ? std::rand() % queries.size() : 0;
+            ss.usequeries = usequeries;
+
+            _initial.setMarking(_net.makeInitialMarking());
+            Structures::State working;
+            working.setMarking(_net.makeInitialMarking());
+
+            W states = _makeStateSet<W>(_net, _kbound, keep_trace, _store);
+            Q queue(seed, threads);
+            std::atomic<bool> stop(false);
+            std::atomic<size_t> expanded(0), explored(1);
+            std::atomic<size_t> heurquery(0);
+            // the workers evaluate the queries without the lock, except bound
+            // queries which record the bound in the query itself
+            std::vector<bool> bounds(queries.size());
+            auto decided = std::make_unique<std::atomic<bool>[]>(queries.size());
+            bool anybounds = false;
+            for(size_t i = 0; i < queries.size(); ++i)
+            {
+                bounds[i] = PQL::containsUpperBounds(queries[i]);
+                anybounds |= bounds[i];
+                decided[i] = results[i] != ResultPrinter::Unknown;
+            }
+
+            auto r = states.add(working, 0);
+            // this can fail due to reductions; we push tokens around and violate K
+            if(r.first){
+                _satisfyingMarking = r.second;
+                if(ss.usequeries && checkQueries(queries, results, working, ss, &states))
+                {
+                    states.synchronize();
+                    if(printstats) printStats(ss, &states);
+                    return true;
+                }
+                heurquery = ss.heurquery;
+                {
+                    PQL::DistanceContext dc(&_net, working.marking());
+                    queue.push(0, r.second, &dc, queries[heurquery].get());
+                }
+
+                std::vector<std::vector<size_t>> fired(threads, std::vector<size_t>(_net.numberOfTransitions(), 0));
+                // errors (e.g. token overflows) are rethrown in the calling thread
+                std::exception_ptr error;
+                std::mutex errorlock;
+                auto worker = [&](uint32_t wid) {
+                  try {
+                    Structures::State state, succ;
+                    state.setMarking(_net.makeInitialMarking());
+                    succ.setMarking(_net.makeInitialMarking());
+                    G generator = _makeSucGen<G>(_net, queries);
+                    auto& counts = fired[wid];
+                    for(auto nid = queue.pop(wid); nid != Q::EMPTY && !stop; nid = queue.pop(wid))
+                    {
+                        states.decode(state, nid, wid);
+                        generator.prepare(&state);
+                        while(!stop && generator.next(succ)){
+                            counts[generator.fired()]++;
+                            auto res = states.add(succ, wid, nid, generator.fired());
+                            if(!res.first) continue;
+                            ++explored;
+                            {
+                                PQL::DistanceContext dc(&_net, succ.marking());
+                                queue.push(wid, res.second, &dc, queries[heurquery].get());
+                            }
+                            if(!ss.usequeries) continue;
+                            bool satisfied = false;
+                            {
+                                PQL::EvaluationContext ec(succ.marking(), &_net);
+                                for(size_t i = 0; i < queries.size() && !satisfied; ++i)
+                                    satisfied = !decided[i] && !bounds[i] &&
+                                        PQL::evaluate(queries[i].get(), ec) == PQL::Condition::RTRUE;
+                            }
+                            if(!satisfied && !anybounds) continue;
+                            std::lock_guard<std::mutex> lk(_queryLock);
+                            if(stop) break;
+                            if(!satisfied)
+                            {
+                                PQL::EvaluationContext ec(succ.marking(), &_net);
+                                for(size_t i = 0; i < queries.size() && !satisfied; ++i)
+                                    satisfied = !decided[i] && bounds[i] &&
+                                        PQL::evaluate(queries[i].get(), ec) == PQL::Condition::RTRUE;
+                                if(!satisfied) continue;
+                            }
+                            // the callbacks report the statistics, publish them first
+                            _satisfyingMarking = res.second;
+                            ss.expandedStates = expanded;
+                            ss.exploredStates = explored;
+                            states.synchronize();
+                            if(checkQueries(queries, results, succ, ss, &states))
+                            {
+                                stop = true;
+                                queue.abort();
+                            }
+                            for(size_t i = 0; i < queries.size(); ++i)
+                                decided[i] = results[i] != ResultPrinter::Unknown;
+                            heurquery = ss.heurquery;
+                        }
+                        ++expanded;
+                    }
+                  } catch(...) {
+                    std::lock_guard<std::mutex> lk(errorlock);
+                    if(!error) error = std::current_exception();
+                    stop = true;
+                    queue.abort();
+                  }
+                };
+
+                std::vector<std::thread> workers;
+                for(uint32_t i = 1; i < threads; ++i)
+                    workers.emplace_back(worker, i);
+                worker(0);
+                for(auto& w : workers)
+                    w.join();
+                if(error)
+                    std::rethrow_exception(error);
+
+                ss.expandedStates = expanded;
+                ss.exploredStates = explored;
+                for(auto& c : fired)
+                    for(size_t t = 0; t < c.size(); ++t)
+                        ss.enabledTransitionsCount[t] += c[t];
+            }
+            states.synchronize();
+
+            if(stop)
+            {
+                if(printstats) printStats(ss, &states);
+                return true;
             }
 
             // no more successors, print last results
@@ -10,6 +10,7 @@
 #define	ALIGNEDENCODER_H
 
 #include <cmath>
+#include <vector>
 #include "utils/structures/binarywrapper.h"
 
 using namespace ptrie;
@@ -35,9 +36,38 @@ class AlignedEncoder
         unsigned char getType(uint32_t sum, uint32_t pwt, bool same, uint32_t val) const;
 
         size_t size(const uchar* data) const;
+
+        /**
+         * In adaptive mode every place is packed into as many bits as the
+         * markings seen so far needed, whenever that is smaller than the
+         * chosen type. The widths only grow, each growth starts a new
+         * generation and a marking is packed with the first generation it
+         * fits, so a marking is always encoded the same way and existing
+         * encodings never need to be rewritten.
+         */
+        void setAdaptive(bool adaptive)
+        {
+            _adaptive = adaptive;
+        }
+
+        /** Number of generations of place widths learned in adaptive mode */
+        size_t generations() const
+        {
+            return _generationBits.size();
+        }
     private:
         uint32_t tokenBytes(uint32_t ntokens) const;
 
+        size_t typeSize(unsigned char type, uint32_t pwt) const;
+
+        size_t encodeFixed(const uint32_t* data, unsigned char type);
+
+        size_t encodeAdaptive(const uint32_t* data, unsigned char type);
+
+        size_t writePacked(size_t offset, const uint32_t* data, size_t generation);
+
+        void readPacked(uint32_t* destination, const unsigned char* source, uint32_t offset, size_t generation) const;
+
         uint32_t writeBitVector(size_t offset, const uint32_t* data);
 
         uint32_t writeTwoBitVector(size_t offset, const uint32_t* data);
@@ -75,6 +105,17 @@ class AlignedEncoder
 
         uint32_t _psize;
 
+        bool _adaptive = false;
+
+        // bits of each place, _places entries per generation
+        std::vector<uint8_t> _widths;
+
+        // total bits of a marking packed with each generation
+        std::vector<size_t> _generationBits;
+
+        // bits needed by each place of the marking being encoded
+        std::vector<uint8_t> _needed;
+
         // dummy value for template
         scratchpad_t _scratchpad;
 
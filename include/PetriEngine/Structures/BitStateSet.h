@@ -0,0 +1,145 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BITSTATESET_H
+#define BITSTATESET_H
+
+#include <vector>
+
+#include "StateSet.h"
+
+namespace PetriEngine {
+    namespace Structures {
+
+        /**
+         * Bitstate hashing (supertrace): visited markings are only recorded
+         * as a number of bits in a fixed size bit array, a marking whose bits
+         * are all set is considered seen. Hash collisions thus prune parts of
+         * the state space, and an exhausted search is not a proof.
+         * Markings waiting in the queue are kept in full until they are
+         * decoded, which frees their id for reuse; every id is decoded once.
+         */
+        class BitStateSet : public StateSetInterface {
+        public:
+            BitStateSet(const PetriNet& net, uint32_t kbound, uint32_t log2bits = 30, uint32_t hashes = 3)
+            : StateSetInterface(net, kbound), _mask((size_t{1} << log2bits) - 1),
+              _hashes(std::max<uint32_t>(hashes, 1))
+            {
+                _bits.resize(std::max<size_t>((size_t{1} << log2bits) / 64, 1), 0);
+            }
+
+            virtual std::pair<bool, size_t> add(const State& state) override
+            {
+                _discovered++;
+
+                MarkVal sum = 0;
+                bool allsame = true;
+                uint32_t val = 0;
+                uint32_t active = 0;
+                uint32_t last = 0;
+                markingStats(state.marking(), sum, allsame, val, active, last);
+
+                if (_maxTokens < sum)
+                    _maxTokens = sum;
+
+                //Check that we're within k-bound
+                if (_kbound != 0 && sum > _kbound)
+                    return std::pair<bool, size_t>(false, std::numeric_limits<size_t>::max());
+
+                unsigned char type = _encoder.getType(sum, active, allsame, val);
+                size_t length = _encoder.encode(state.marking(), type);
+                const ptrie::uchar* data = _encoder.scratchpad().const_raw();
+
+                // double hashing, bit i is h1 + i*h2
+                uint64_t h1 = encodingHash(data, length);
+                uint64_t h2 = ((h1 >> 32) | (h1 << 32)) * 0x9E3779B97F4A7C15ULL | 1;
+                bool seen = true;
+                for(uint32_t i = 0; i < _hashes; ++i)
+                {
+                    size_t bit = (h1 + i * h2) & _mask;
+                    uint64_t flag = uint64_t{1} << (bit % 64);
+                    if((_bits[bit / 64] & flag) == 0)
+                    {
+                        seen = false;
+                        _bits[bit / 64] |= flag;
+                    }
+                }
+                if(seen)
+                    return std::pair<bool, size_t>(false, std::numeric_limits<size_t>::max());
+
+                size_t id;
+                if(_free.empty())
+                {
+                    id = _pending.size();
+                    _pending.emplace_back();
+                }
+                else
+                {
+                    id = _free.back();
+                    _free.pop_back();
+                }
+                _pending[id].assign(data, data + length);
+                ++_stored;
+
+                // update the max token bound for each place in the net (only for newly discovered markings)
+                for (uint32_t i = 0; i < _net.numberOfPlaces(); i++)
+                {
+                    _maxPlaceBound[i] = std::max<MarkVal>( state.marking()[i],
+                                                            _maxPlaceBound[i]);
+                }
+                return std::pair<bool, size_t>(true, id);
+            }
+
+            virtual void decode(State& state, size_t id) override
+            {
+                _encoder.decode(state.marking(), _pending[id].data());
+                _free.push_back(id);
+            }
+
+            virtual std::pair<bool, size_t> lookup(State& state) override
+            {
+                assert(false);
+                return std::make_pair(false, std::numeric_limits<size_t>::max());
+            }
+
+            virtual void setHistory(size_t id, size_t transition) override {}
+
+            virtual std::pair<size_t, size_t> getHistory(size_t markingid) override
+            {
+                assert(false);
+                return std::make_pair(0,0);
+            }
+
+            virtual size_t memoryUsage() const override
+            {
+                return _bits.size() * sizeof(uint64_t);
+            }
+
+            /** Number of markings recorded in the bit array */
+            size_t stored() const { return _stored; }
+
+        private:
+            size_t _mask;
+            uint32_t _hashes;
+            std::vector<uint64_t> _bits;
+            // encodings of the markings not yet decoded, indexed by id
+            std::vector<std::vector<ptrie::uchar>> _pending;
+            std::vector<size_t> _free;
+            size_t _stored = 0;
+        };
+    }
+}
+
+#endif // BITSTATESET_H
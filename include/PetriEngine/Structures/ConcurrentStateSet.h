@@ -0,0 +1,264 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CONCURRENTSTATESET_H
+#define CONCURRENTSTATESET_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "StateSet.h"
+
+namespace PetriEngine {
+    namespace Structures {
+
+        /**
+         * Common ground for state sets shared between several worker threads.
+         * Every worker owns an encoder, so encoding happens outside of any
+         * critical section, and the statistics are gathered in atomics until
+         * they are published by synchronize().
+         */
+        class ParallelStateSetInterface : public StateSetInterface {
+        public:
+            ParallelStateSetInterface(const PetriNet& net, uint32_t kbound, uint32_t workers, bool tracable)
+            : StateSetInterface(net, kbound), _tracable(tracable)
+            {
+                for(uint32_t w = 0; w < std::max<uint32_t>(workers, 1); ++w)
+                    _encoders.emplace_back(std::make_unique<AlignedEncoder>(_nplaces, kbound));
+                _placeBounds = std::make_unique<std::atomic<uint32_t>[]>(net.numberOfPlaces());
+                for(size_t p = 0; p < net.numberOfPlaces(); ++p)
+                    _placeBounds[p] = 0;
+            }
+
+            virtual std::pair<bool, size_t> add(const State& state, uint32_t worker, size_t parent = 0, uint32_t transition = 0) = 0;
+
+            virtual void decode(State& state, size_t id, uint32_t worker) = 0;
+
+            virtual std::pair<bool, size_t> add(const State& state) override
+            {
+                return add(state, 0);
+            }
+
+            virtual void decode(State& state, size_t id) override
+            {
+                decode(state, id, 0);
+            }
+
+            // history is recorded as part of add
+            virtual void setHistory(size_t id, size_t transition) override {}
+
+            /**
+             * Publishes the statistics gathered by the workers in the fields
+             * read by discovered(), maxTokens() and maxPlaceBound().
+             */
+            void synchronize()
+            {
+                _discovered = _sharedDiscovered;
+                _maxTokens = _sharedMaxTokens;
+                for(size_t p = 0; p < _net.numberOfPlaces(); ++p)
+                    _maxPlaceBound[p] = _placeBounds[p];
+            }
+
+        protected:
+            // ids of the parallel sets are composed (shard and index, or a
+            // slot of a large table) and do not fit the ptrie::uint of traceable_t
+            struct parallel_traceable_t {
+                size_t parent;
+                uint32_t transition;
+            };
+
+            /**
+             * Counts and encodes the marking into the scratchpad of the
+             * workers encoder, returns the length of the encoding or zero if
+             * the marking violates the k-bound.
+             */
+            size_t _encode(const State& state, uint32_t worker)
+            {
+                ++_sharedDiscovered;
+
+                MarkVal sum = 0;
+                bool allsame = true;
+                uint32_t val = 0;
+                uint32_t active = 0;
+                uint32_t last = 0;
+                markingStats(state.marking(), sum, allsame, val, active, last);
+
+                atomicMax(_sharedMaxTokens, sum);
+
+                //Check that we're within k-bound
+                if (_kbound != 0 && sum > _kbound)
+                    return 0;
+
+                auto& encoder = *_encoders[worker];
+                unsigned char type = encoder.getType(sum, active, allsame, val);
+                return encoder.encode(state.marking(), type);
+            }
+
+            // update the max token bound for each place in the net (only for newly discovered markings)
+            void _updateBounds(const State& state)
+            {
+                for (uint32_t i = 0; i < _net.numberOfPlaces(); i++)
+                    atomicMax(_placeBounds[i], state.marking()[i]);
+            }
+
+            static void atomicMax(std::atomic<uint32_t>& target, uint32_t value)
+            {
+                auto old = target.load(std::memory_order_relaxed);
+                while(old < value && !target.compare_exchange_weak(old, value, std::memory_order_relaxed)) {}
+            }
+
+            bool _tracable;
+            std::vector<std::unique_ptr<AlignedEncoder>> _encoders;
+
+        private:
+            std::unique_ptr<std::atomic<uint32_t>[]> _placeBounds;
+            std::atomic<size_t> _sharedDiscovered{0};
+            std::atomic<uint32_t> _sharedMaxTokens{0};
+        };
+
+        /**
+         * Markings are distributed over a number of ptrie shards by the hash of
+         * their encoding, each shard protected by its own lock.
+         * Marking ids are composed as (local id * shards + shard), where the
+         * shards are rotated such that the first marking added gets id 0, as
+         * assumed by the trace printer.
+         */
+        class ConcurrentStateSet : public ParallelStateSetInterface {
+        private:
+            using ptrie_t = ptrie::set_stable<ptrie::uchar,17,128,4>;
+
+            struct shard_t {
+                std::mutex _lock;
+                ptrie_t _trie;
+                std::vector<parallel_traceable_t> _history;
+            };
+
+        public:
+            ConcurrentStateSet(const PetriNet& net, uint32_t kbound, uint32_t workers, bool tracable = false)
+            : ParallelStateSetInterface(net, kbound, workers, tracable)
+            {
+                // over-provision shards to keep contention on the locks low
+                size_t nshards = 1;
+                _shardbits = 0;
+                while(nshards < workers * 8)
+                {
+                    nshards <<= 1;
+                    ++_shardbits;
+                }
+                _shards = std::vector<shard_t>(nshards);
+            }
+
+            using ParallelStateSetInterface::add;
+            using ParallelStateSetInterface::decode;
+
+            virtual std::pair<bool, size_t> add(const State& state, uint32_t worker, size_t parent = 0, uint32_t transition = 0) override
+            {
+                size_t length = _encode(state, worker);
+                if(length == 0)
+                    return std::pair<bool, size_t>(false, std::numeric_limits<size_t>::max());
+                if(length*8 >= std::numeric_limits<uint16_t>::max())
+                {
+                    throw base_error("Marking could not be encoded into less than 2^16 bytes, current limit of PTries");
+                }
+
+                auto& encoder = *_encoders[worker];
+                auto sid = shardOf(encoder.scratchpad().raw(), length);
+                auto& shard = _shards[sid];
+                std::pair<bool, size_t> tit;
+                {
+                    std::lock_guard<std::mutex> guard(shard._lock);
+                    tit = shard._trie.insert(encoder.scratchpad().raw(), length);
+                    if(tit.first && _tracable)
+                    {
+                        if(shard._history.size() <= tit.second)
+                            shard._history.resize(tit.second + 1);
+                        shard._history[tit.second] = parallel_traceable_t{parent, transition};
+                    }
+                }
+                auto id = (tit.second << _shardbits) | sid;
+                if(!tit.first)
+                    return std::pair<bool, size_t>(false, id);
+
+                _updateBounds(state);
+                return std::pair<bool, size_t>(true, id);
+            }
+
+            virtual void decode(State& state, size_t id, uint32_t worker) override
+            {
+                auto& encoder = *_encoders[worker];
+                auto& shard = _shards[id & (_shards.size() - 1)];
+                {
+                    std::lock_guard<std::mutex> guard(shard._lock);
+                    shard._trie.unpack(id >> _shardbits, encoder.scratchpad().raw());
+                }
+                encoder.decode(state.marking(), encoder.scratchpad().raw());
+            }
+
+            virtual std::pair<bool, size_t> lookup(State& state) override
+            {
+                MarkVal sum = 0;
+                bool allsame = true;
+                uint32_t val = 0;
+                uint32_t active = 0;
+                uint32_t last = 0;
+                markingStats(state.marking(), sum, allsame, val, active, last);
+
+                auto& encoder = *_encoders[0];
+                unsigned char type = encoder.getType(sum, active, allsame, val);
+                size_t length = encoder.encode(state.marking(), type);
+                auto sid = shardOf(encoder.scratchpad().raw(), length);
+                auto& shard = _shards[sid];
+                std::lock_guard<std::mutex> guard(shard._lock);
+                auto tit = shard._trie.exists(encoder.scratchpad().raw(), length);
+                if(tit.first)
+                    return std::make_pair(true, (tit.second << _shardbits) | sid);
+                return std::make_pair(false, std::numeric_limits<size_t>::max());
+            }
+
+            virtual std::pair<size_t, size_t> getHistory(size_t markingid) override
+            {
+                assert(_tracable);
+                auto& shard = _shards[markingid & (_shards.size() - 1)];
+                std::lock_guard<std::mutex> guard(shard._lock);
+                auto& t = shard._history[markingid >> _shardbits];
+                return std::pair<size_t, size_t>(t.parent, t.transition);
+            }
+
+        private:
+            size_t shardOf(const ptrie::uchar* data, size_t length)
+            {
+                auto h = encodingHash(data, length);
+                auto mask = _shards.size() - 1;
+                // the first marking we see is the root, rotate it into shard 0.
+                if(!_rotated)
+                {
+                    _rotation = (_shards.size() - (h & mask)) & mask;
+                    _rotated = true;
+                }
+                return (h + _rotation) & mask;
+            }
+
+            size_t _shardbits;
+            std::vector<shard_t> _shards;
+            // only written by the first add, which happens before workers are spawned
+            bool _rotated = false;
+            size_t _rotation = 0;
+        };
+    }
+}
+
+#endif // CONCURRENTSTATESET_H
@@ -0,0 +1,247 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DELTASTATESET_H
+#define DELTASTATESET_H
+
+#include <memory>
+#include <vector>
+
+#include "StateSet.h"
+
+namespace PetriEngine {
+    namespace Structures {
+
+        /**
+         * Tracable state set storing most markings as the transition fired
+         * from their parent. Only markings at least checkpoint steps away
+         * from the last fully stored ancestor are stored as a full encoding;
+         * the others are reconstructed on decode by firing the transitions
+         * from that ancestor.
+         * Duplicates are found through a hash table of (fingerprint, id),
+         * where candidates are reconstructed and compared to the marking.
+         */
+        class DeltaStateSet : public StateSetInterface {
+        private:
+            static constexpr uint32_t NO_ENCODING = std::numeric_limits<uint32_t>::max();
+
+            struct entry_t {
+                uint32_t parent;
+                uint32_t transition;
+                // index into _offsets, or NO_ENCODING if stored as a delta
+                uint32_t full;
+            };
+
+        public:
+            DeltaStateSet(const PetriNet& net, uint32_t kbound, uint32_t checkpoint = 8)
+            : StateSetInterface(net, kbound), _checkpoint(std::max<uint32_t>(checkpoint, 1)),
+              _table(1024, 0), _tmp(std::make_unique<MarkVal[]>(net.numberOfPlaces()))
+            {
+            }
+
+            virtual std::pair<bool, size_t> add(const State& state) override
+            {
+                _discovered++;
+
+                MarkVal sum = 0;
+                bool allsame = true;
+                uint32_t val = 0;
+                uint32_t active = 0;
+                uint32_t last = 0;
+                markingStats(state.marking(), sum, allsame, val, active, last);
+
+                if (_maxTokens < sum)
+                    _maxTokens = sum;
+
+                //Check that we're within k-bound
+                if (_kbound != 0 && sum > _kbound)
+                    return std::pair<bool, size_t>(false, std::numeric_limits<size_t>::max());
+
+                unsigned char type = _encoder.getType(sum, active, allsame, val);
+                size_t length = _encoder.encode(state.marking(), type);
+                auto hash = encodingHash(_encoder.scratchpad().const_raw(), length);
+                auto slot = _find(state.marking(), hash);
+                if(_table[slot] != 0)
+                    return std::pair<bool, size_t>(false, _id(_table[slot]));
+
+                if(_entries.size() == NO_ENCODING)
+                    throw base_error("More than 2^32 markings, current limit of the delta state store");
+
+                // stored in full until setHistory tells where the marking came from
+                uint32_t id = _entries.size();
+                _entries.push_back(entry_t{0, 0, (uint32_t)_offsets.size()});
+                _offsets.push_back(_encodings.size());
+                auto* data = _encoder.scratchpad().const_raw();
+                _encodings.insert(_encodings.end(), data, data + length);
+                _table[slot] = _slot(hash, id);
+                _storedBytes += length;
+                if(_entries.size() * 4 > _table.size() * 3)
+                    _grow();
+
+                // update the max token bound for each place in the net (only for newly discovered markings)
+                for (uint32_t i = 0; i < _net.numberOfPlaces(); i++)
+                {
+                    _maxPlaceBound[i] = std::max<MarkVal>( state.marking()[i],
+                                                            _maxPlaceBound[i]);
+                }
+                return std::pair<bool, size_t>(true, id);
+            }
+
+            virtual void decode(State& state, size_t id) override
+            {
+                _parent = id;
+                _reconstruct(state.marking(), id);
+            }
+
+            virtual std::pair<bool, size_t> lookup(State& state) override
+            {
+                MarkVal sum = 0;
+                bool allsame = true;
+                uint32_t val = 0;
+                uint32_t active = 0;
+                uint32_t last = 0;
+                markingStats(state.marking(), sum, allsame, val, active, last);
+
+                unsigned char type = _encoder.getType(sum, active, allsame, val);
+                size_t length = _encoder.encode(state.marking(), type);
+                auto slot = _find(state.marking(), encodingHash(_encoder.scratchpad().const_raw(), length));
+                if(_table[slot] != 0)
+                    return std::make_pair(true, _id(_table[slot]));
+                return std::make_pair(false, std::numeric_limits<size_t>::max());
+            }
+
+            virtual void setHistory(size_t id, size_t transition) override
+            {
+                auto& e = _entries[id];
+                e.parent = _parent;
+                e.transition = transition;
+                // the newest encoding can be dropped again if an ancestor close enough is stored in full
+                if(e.full != NO_ENCODING && e.full + 1 == _offsets.size() &&
+                   _distance(_parent) + 1 < _checkpoint)
+                {
+                    _storedBytes -= _encodings.size() - _offsets.back();
+                    _encodings.resize(_offsets.back());
+                    _offsets.pop_back();
+                    e.full = NO_ENCODING;
+                }
+            }
+
+            virtual std::pair<size_t, size_t> getHistory(size_t markingid) override
+            {
+                auto& e = _entries[markingid];
+                return std::pair<size_t, size_t>(e.parent, e.transition);
+            }
+
+            virtual size_t memoryUsage() const override
+            {
+                return _storedBytes + _entries.size() * sizeof(entry_t)
+                    + _offsets.size() * sizeof(size_t) + _table.size() * sizeof(uint64_t);
+            }
+
+        private:
+            static uint64_t _slot(size_t hash, uint32_t id)
+            {
+                // the upper half of the hash picks the bucket, the lower half is kept as fingerprint
+                return (uint64_t(uint32_t(hash)) << 32) | (uint64_t(id) + 1);
+            }
+
+            static uint32_t _id(uint64_t slot)
+            {
+                return uint32_t(slot) - 1;
+            }
+
+            size_t _bucket(size_t hash) const
+            {
+                return (hash >> 32) & (_table.size() - 1);
+            }
+
+            // slot holding the marking, or the empty slot it should go to
+            size_t _find(const MarkVal* marking, size_t hash)
+            {
+                auto mask = _table.size() - 1;
+                uint64_t fingerprint = uint32_t(hash);
+                for(size_t i = _bucket(hash);; i = (i + 1) & mask)
+                {
+                    auto slot = _table[i];
+                    if(slot == 0)
+                        return i;
+                    if((slot >> 32) != fingerprint)
+                        continue;
+                    _reconstruct(_tmp.get(), _id(slot));
+                    if(memcmp(_tmp.get(), marking, sizeof(MarkVal) * _net.numberOfPlaces()) == 0)
+                        return i;
+                }
+            }
+
+            void _grow()
+            {
+                // only fingerprints are kept, so the buckets are found by reconstructing the markings
+                std::vector<uint64_t> table(_table.size() * 2, 0);
+                auto mask = table.size() - 1;
+                for(uint32_t id = 0; id < _entries.size(); ++id)
+                {
+                    _reconstruct(_tmp.get(), id);
+                    auto stats = Structures::markingStats(_tmp.get(), _nplaces);
+                    unsigned char type = _encoder.getType(stats.sum, stats.active, stats.allsame, stats.max);
+                    size_t length = _encoder.encode(_tmp.get(), type);
+                    auto hash = encodingHash(_encoder.scratchpad().const_raw(), length);
+                    size_t i = (hash >> 32) & mask;
+                    while(table[i] != 0)
+                        i = (i + 1) & mask;
+                    table[i] = _slot(hash, id);
+                }
+                _table.swap(table);
+            }
+
+            // number of deltas between id and its closest fully stored ancestor
+            uint32_t _distance(size_t id) const
+            {
+                uint32_t distance = 0;
+                for(; _entries[id].full == NO_ENCODING; id = _entries[id].parent)
+                    ++distance;
+                return distance;
+            }
+
+            void _reconstruct(MarkVal* marking, size_t id)
+            {
+                _path.clear();
+                for(; _entries[id].full == NO_ENCODING; id = _entries[id].parent)
+                    _path.push_back(_entries[id].transition);
+                _encoder.decode(marking, &_encodings[_offsets[_entries[id].full]]);
+                for(auto t = _path.rbegin(); t != _path.rend(); ++t)
+                {
+                    auto [finv, linv] = _net.preset(*t);
+                    for(; finv != linv; ++finv)
+                        if(!finv->inhibitor)
+                            marking[finv->place] -= finv->tokens;
+                    auto [fout, lout] = _net.postset(*t);
+                    for(; fout != lout; ++fout)
+                        marking[fout->place] += fout->tokens;
+                }
+            }
+
+            uint32_t _checkpoint;
+            std::vector<entry_t> _entries;
+            std::vector<size_t> _offsets;
+            std::vector<ptrie::uchar> _encodings;
+            std::vector<uint64_t> _table;
+            std::unique_ptr<MarkVal[]> _tmp;
+            std::vector<uint32_t> _path;
+            size_t _parent = 0;
+        };
+    }
+}
+
+#endif // DELTASTATESET_H
@@ -0,0 +1,221 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef HASHSTATESET_H
+#define HASHSTATESET_H
+
+#include <new>
+#include <thread>
+
+#include "ConcurrentStateSet.h"
+
+namespace PetriEngine {
+    namespace Structures {
+
+        /**
+         * Lock-free open-addressing hash table over encoded markings.
+         * The table has a fixed number of slots (2^log2size), chosen up front.
+         * Each slot has a control word holding (hash tag, state); the slot is
+         * claimed by a CAS from empty to writing, filled and then published as
+         * done. Encodings of up to SLOT_BYTES bytes are stored inline in the
+         * slot, longer ones are placed in a per-worker overflow arena and the
+         * slot keeps a pointer to them.
+         * The id of a marking is its slot index; the slots are rotated such
+         * that the first marking added gets id 0, as assumed by the trace printer.
+         */
+        class HashStateSet : public ParallelStateSetInterface {
+        private:
+            static constexpr size_t SLOT_BYTES = 16;
+            static constexpr size_t ARENA_BYTES = 1024*1024;
+            static constexpr uint64_t EMPTY = 0;
+            static constexpr uint64_t WRITING = 1;
+            static constexpr uint64_t DONE = 2;
+
+            struct arena_t {
+                std::vector<std::unique_ptr<ptrie::uchar[]>> _chunks;
+                size_t _offset = ARENA_BYTES;
+            };
+
+        public:
+            HashStateSet(const PetriNet& net, uint32_t kbound, uint32_t workers = 1, bool tracable = false, uint32_t log2size = 22)
+            : ParallelStateSetInterface(net, kbound, workers, tracable),
+              _capacity(size_t{1} << log2size), _arenas(std::max<uint32_t>(workers, 1))
+            {
+                try {
+                    _table = std::make_unique<std::atomic<uint64_t>[]>(_capacity);
+                    _data = std::make_unique<ptrie::uchar[]>(_capacity * SLOT_BYTES);
+                    _lengths = std::make_unique<uint16_t[]>(_capacity);
+                    if(_tracable)
+                        _history = std::make_unique<parallel_traceable_t[]>(_capacity);
+                } catch(const std::bad_alloc&) {
+                    throw base_error("Could not allocate the hash state store (", _capacity, " slots), decrease --hash-size");
+                }
+                for(size_t i = 0; i < _capacity; ++i)
+                    _table[i].store(EMPTY, std::memory_order_relaxed);
+            }
+
+            using ParallelStateSetInterface::add;
+            using ParallelStateSetInterface::decode;
+
+            virtual std::pair<bool, size_t> add(const State& state, uint32_t worker, size_t parent = 0, uint32_t transition = 0) override
+            {
+                size_t length = _encode(state, worker);
+                if(length == 0)
+                    return std::pair<bool, size_t>(false, std::numeric_limits<size_t>::max());
+                if(length >= std::numeric_limits<uint16_t>::max())
+                    throw base_error("Marking could not be encoded into less than 2^16 bytes, current limit of the hash state store");
+
+                const ptrie::uchar* enc = _encoders[worker]->scratchpad().const_raw();
+                auto h = encodingHash(enc, length);
+                uint64_t tag = (h >> 2) << 2;
+                auto mask = _capacity - 1;
+                if(!_rotated)
+                {
+                    // the first marking we see is the root, rotate it into slot 0.
+                    _rotation = (_capacity - (h & mask)) & mask;
+                    _rotated = true;
+                }
+                size_t idx = (h + _rotation) & mask;
+                for(size_t probe = 0; probe < _capacity; ++probe, idx = (idx + 1) & mask)
+                {
+                    auto& ctrl = _table[idx];
+                    uint64_t cur = ctrl.load(std::memory_order_acquire);
+                    if(cur == EMPTY)
+                    {
+                        // reserve room before claiming the slot, a slot left in WRITING
+                        // would block every worker probing it with the same tag
+                        if(++_size > _capacity - (_capacity / 16))
+                        {
+                            --_size;
+                            throw base_error("The hash state store is full (", _capacity, " slots), increase --hash-size");
+                        }
+                        if(ctrl.compare_exchange_strong(cur, tag | WRITING, std::memory_order_acq_rel))
+                        {
+                            _store(idx, enc, length, worker);
+                            if(_tracable)
+                                _history[idx] = parallel_traceable_t{parent, transition};
+                            ctrl.store(tag | DONE, std::memory_order_release);
+                            _updateBounds(state);
+                            return std::pair<bool, size_t>(true, idx);
+                        }
+                        // lost the race, cur now holds the winning control word
+                        --_size;
+                    }
+                    if((cur & ~uint64_t{3}) != tag)
+                        continue;
+                    while((cur & 3) == WRITING)
+                    {
+                        std::this_thread::yield();
+                        cur = ctrl.load(std::memory_order_acquire);
+                    }
+                    if(_lengths[idx] == length && memcmp(_get(idx), enc, length) == 0)
+                        return std::pair<bool, size_t>(false, idx);
+                }
+                throw base_error("The hash state store is full (", _capacity, " slots), increase --hash-size");
+            }
+
+            virtual void decode(State& state, size_t id, uint32_t worker) override
+            {
+                assert((_table[id].load(std::memory_order_acquire) & 3) == DONE);
+                _encoders[worker]->decode(state.marking(), _get(id));
+            }
+
+            virtual std::pair<bool, size_t> lookup(State& state) override
+            {
+                MarkVal sum = 0;
+                bool allsame = true;
+                uint32_t val = 0;
+                uint32_t active = 0;
+                uint32_t last = 0;
+                markingStats(state.marking(), sum, allsame, val, active, last);
+
+                auto& encoder = *_encoders[0];
+                unsigned char type = encoder.getType(sum, active, allsame, val);
+                size_t length = encoder.encode(state.marking(), type);
+                const ptrie::uchar* enc = encoder.scratchpad().const_raw();
+                auto h = encodingHash(enc, length);
+                uint64_t tag = (h >> 2) << 2;
+                auto mask = _capacity - 1;
+                size_t idx = (h + _rotation) & mask;
+                for(size_t probe = 0; probe < _capacity; ++probe, idx = (idx + 1) & mask)
+                {
+                    uint64_t cur = _table[idx].load(std::memory_order_acquire);
+                    if(cur == EMPTY)
+                        break;
+                    if((cur & 3) == DONE && (cur & ~uint64_t{3}) == tag &&
+                       _lengths[idx] == length && memcmp(_get(idx), enc, length) == 0)
+                        return std::make_pair(true, idx);
+                }
+                return std::make_pair(false, std::numeric_limits<size_t>::max());
+            }
+
+            virtual std::pair<size_t, size_t> getHistory(size_t markingid) override
+            {
+                assert(_tracable);
+                auto& t = _history[markingid];
+                return std::pair<size_t, size_t>(t.parent, t.transition);
+            }
+
+            size_t size() const { return _size; }
+            size_t capacity() const { return _capacity; }
+
+        private:
+            void _store(size_t idx, const ptrie::uchar* enc, size_t length, uint32_t worker)
+            {
+                _lengths[idx] = length;
+                ptrie::uchar* slot = &_data[idx * SLOT_BYTES];
+                if(length <= SLOT_BYTES)
+                {
+                    memcpy(slot, enc, length);
+                    return;
+                }
+                // too long for the slot, keep a pointer to the overflow arena instead
+                auto& arena = _arenas[worker];
+                if(arena._offset + length > ARENA_BYTES || arena._chunks.empty())
+                {
+                    arena._chunks.emplace_back(std::make_unique<ptrie::uchar[]>(std::max(ARENA_BYTES, length)));
+                    arena._offset = 0;
+                }
+                ptrie::uchar* dest = arena._chunks.back().get() + arena._offset;
+                arena._offset += length;
+                memcpy(dest, enc, length);
+                memcpy(slot, &dest, sizeof(dest));
+            }
+
+            const ptrie::uchar* _get(size_t idx) const
+            {
+                const ptrie::uchar* slot = &_data[idx * SLOT_BYTES];
+                if(_lengths[idx] <= SLOT_BYTES)
+                    return slot;
+                const ptrie::uchar* ptr;
+                memcpy(&ptr, slot, sizeof(ptr));
+                return ptr;
+            }
+
+            size_t _capacity;
+            std::unique_ptr<std::atomic<uint64_t>[]> _table;
+            std::unique_ptr<ptrie::uchar[]> _data;
+            std::unique_ptr<uint16_t[]> _lengths;
+            std::unique_ptr<parallel_traceable_t[]> _history;
+            std::vector<arena_t> _arenas;
+            std::atomic<size_t> _size{0};
+            // only written by the first add, which happens before workers are spawned
+            bool _rotated = false;
+            size_t _rotation = 0;
+        };
+    }
+}
+
+#endif // HASHSTATESET_H
@@ -0,0 +1,46 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MARKINGKERNELS_H
+#define MARKINGKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace PetriEngine {
+    namespace Structures {
+
+        struct marking_stats_t {
+            uint64_t sum = 0;
+            // largest number of tokens in a place
+            uint32_t max = 0;
+            // number of marked places
+            uint32_t active = 0;
+            // index of the last marked place
+            uint32_t last = 0;
+            // all marked places hold the same number of tokens
+            bool allsame = true;
+        };
+
+        /**
+         * Computes the statistics used for choosing the encoding of a marking
+         * in a single pass. Uses AVX2 or SSE4.1 when the CPU supports it,
+         * chosen on first use, and a scalar loop otherwise.
+         */
+        marking_stats_t markingStats(const uint32_t* marking, size_t nplaces);
+    }
+}
+
+#endif // MARKINGKERNELS_H
@@ -0,0 +1,125 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SPILLINGSTATESET_H
+#define SPILLINGSTATESET_H
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "StateSet.h"
+
+namespace PetriEngine {
+    namespace Structures {
+
+        /**
+         * State set for a layered breadth-first search with delayed duplicate
+         * detection, keeping the state space on disk.
+         * The visited markings are kept in a single sorted file. Successors
+         * are only collected while a layer is expanded; once they exceed the
+         * memory limit they are sorted and written to a run on disk. When the
+         * layer is done, the runs are merged with the visited file, and the
+         * markings not seen before form the next layer.
+         * Markings have no ids here, so traces are not supported.
+         */
+        class SpillingStateSet : public StateSetInterface {
+        public:
+            SpillingStateSet(const PetriNet& net, uint32_t kbound, size_t memorylimit);
+
+            /** Takes over the statistics of the in-memory set being spilled */
+            void inherit(const StateSetInterface& states);
+
+            /** Adds a marking that was already expanded or is in the frontier */
+            void addVisited(const State& state);
+
+            /** Adds a marking that still needs to be expanded */
+            void addFrontier(const State& state);
+
+            /** Merges the markings given by addVisited into the visited file */
+            void seal();
+
+            /**
+             * Adds a successor of the current layer. Whether it is new is only
+             * known after nextLayer, hence no id is returned.
+             */
+            virtual std::pair<bool, size_t> add(const State& state) override;
+
+            /** Reads the next marking of the current layer, false once exhausted */
+            bool nextFrontier(State& state);
+
+            /**
+             * Completes the current layer; onNew is called for every new
+             * marking and may stop the search by returning true.
+             * Returns true if the search was stopped.
+             */
+            bool nextLayer(State& state, const std::function<bool(State&)>& onNew);
+
+            bool frontierEmpty() const { return _frontierSize == 0; }
+
+            size_t spilledRuns() const { return _spills; }
+
+            virtual size_t memoryUsage() const override {
+                return _buffer.size() + _offsets.size() * sizeof(size_t);
+            }
+
+            virtual void decode(State& state, size_t id) override
+            {
+                assert(false);
+            }
+
+            virtual std::pair<bool, size_t> lookup(State& state) override
+            {
+                assert(false);
+                return std::make_pair(false, std::numeric_limits<size_t>::max());
+            }
+
+            virtual void setHistory(size_t id, size_t transition) override {}
+
+            virtual std::pair<size_t, size_t> getHistory(size_t markingid) override
+            {
+                assert(false);
+                return std::make_pair(0,0);
+            }
+
+        private:
+            using file_t = std::unique_ptr<FILE, int(*)(FILE*)>;
+
+            static file_t _tmpfile();
+            static void _write(FILE* file, const ptrie::uchar* data, uint16_t length);
+            static bool _read(FILE* file, std::vector<ptrie::uchar>& record);
+
+            size_t _encode(const State& state);
+            void _append(const State& state);
+            void _spill();
+            bool _merge(State& state, const std::function<bool(State&)>* onNew);
+
+            size_t _memorylimit;
+            // successors of the current layer, as (length, encoding) records
+            std::vector<ptrie::uchar> _buffer;
+            std::vector<size_t> _offsets;
+            std::vector<file_t> _runs;
+            file_t _visited;
+            file_t _frontier;
+            file_t _next;
+            size_t _frontierSize = 0;
+            size_t _spills = 0;
+            std::vector<ptrie::uchar> _record;
+        };
+    }
+}
+
+#endif // SPILLINGSTATESET_H
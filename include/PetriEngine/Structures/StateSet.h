@@ -20,8 +20,10 @@
 #include <ptrie/ptrie_map.h>
 #include <unordered_map>
 #include <iostream>
+#include <chrono>
 #include "State.h"
 #include "AlignedEncoder.h"
+#include "MarkingKernels.h"
 #include "utils/structures/binarywrapper.h"
 #include "utils/errors.h"
 
@@ -34,7 +36,7 @@ namespace PetriEngine {
         public:
             StateSetInterface(const PetriNet& net, uint32_t kbound, int nplaces = -1) :
             _nplaces(nplaces == -1 ? net.numberOfPlaces() : nplaces),
-            _encoder(_nplaces, kbound), _net(net)
+            _encoder(_nplaces, kbound), _net(net), _created(std::chrono::steady_clock::now())
             {
                 _discovered = 0;
                 _kbound = kbound;
@@ -75,6 +77,8 @@ namespace PetriEngine {
             AlignedEncoder _encoder;
             const PetriNet& _net;
             binarywrapper_t _sp;
+            std::chrono::steady_clock::time_point _created;
+            size_t _storedBytes = 0;
 #ifdef DEBUG
             std::vector<uint32_t*> _dbg;
 #endif
@@ -89,8 +93,11 @@ namespace PetriEngine {
 #endif
             }
 
-            template<typename T>
-            std::pair<bool, size_t> _add(const State& state, T& _trie) {
+            /**
+             * Counts the marking and encodes it into the scratchpad, returns
+             * the length of the encoding or zero if it violates the k-bound.
+             */
+            size_t _encodeForInsert(const State& state) {
                 _discovered++;
 
 #ifdef DEBUG
@@ -109,7 +116,7 @@ namespace PetriEngine {
 
                 //Check that we're within k-bound
                 if (_kbound != 0 && sum > _kbound)
-                    return std::pair<bool, size_t>(false, std::numeric_limits<size_t>::max());
+                    return 0;
 
                 unsigned char type = _encoder.getType(sum, active, allsame, val);
 
@@ -119,8 +126,12 @@ namespace PetriEngine {
                 {
                     throw base_error("Marking could not be encoded into less than 2^16 bytes, current limit of PTries");
                 }
-                binarywrapper_t w = binarywrapper_t(_encoder.scratchpad().raw(), length*8);
-                auto tit = _trie.insert(w.raw(), w.size());
+                return length;
+            }
+
+            template<typename T>
+            std::pair<bool, size_t> _insert(const State& state, const ptrie::uchar* data, size_t length, T& _trie) {
+                auto tit = _trie.insert(data, length);
 
 
                 if(!tit.first)
@@ -141,12 +152,24 @@ namespace PetriEngine {
                                                             _maxPlaceBound[i]);
                 }
 
+                // the encoding plus a rough estimate of the trie bookkeeping per marking
+                _storedBytes += length + 2 * sizeof(size_t);
+
 #ifdef DEBUG
                 if(_trie.size() % 100000 == 0) std::cout << "Inserted " << _trie.size() << std::endl;
 #endif
                 return std::pair<bool, size_t>(true, tit.second);
             }
 
+            template<typename T>
+            std::pair<bool, size_t> _add(const State& state, T& _trie) {
+                size_t length = _encodeForInsert(state);
+                if(length == 0)
+                    return std::pair<bool, size_t>(false, std::numeric_limits<size_t>::max());
+                binarywrapper_t w = binarywrapper_t(_encoder.scratchpad().raw(), length*8);
+                return _insert(state, w.raw(), w.size(), _trie);
+            }
+
             template <typename T>
             std::pair<bool, size_t> _lookup(const State& state, T& _trie) {
                 MarkVal sum = 0;
@@ -175,6 +198,22 @@ namespace PetriEngine {
                 return _discovered;
             }
 
+            /** Markings discovered per second since the set was created, the rate of the whole exploration */
+            double discoveryRate() const {
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _created;
+                return elapsed.count() > 0 ? _discovered / elapsed.count() : 0;
+            }
+
+            /** Packs markings with place widths learned during the search, see AlignedEncoder::setAdaptive */
+            void setAdaptiveEncoding(bool adaptive) {
+                _encoder.setAdaptive(adaptive);
+            }
+
+            /** Estimate of the number of bytes used to store the markings */
+            virtual size_t memoryUsage() const {
+                return _storedBytes;
+            }
+
             uint32_t maxTokens() const {
                 return _maxTokens;
             }
@@ -183,25 +222,46 @@ namespace PetriEngine {
                 return _maxPlaceBound;
             }
 
-        protected:
-
-            void markingStats(const uint32_t* marking, MarkVal& sum, bool& allsame, uint32_t& val, uint32_t& active, uint32_t& last)
+            /**
+             * Mixes an encoded marking into a 64 bit hash (murmur3 finalizer over 8 byte words).
+             * Also distributes the markings of the CTL dependency graph over its shards.
+             */
+            static size_t encodingHash(const ptrie::uchar* data, size_t length)
             {
-                uint32_t cnt = 0;
-
-                for (uint32_t i = 0; i < _nplaces; i++)
+                uint64_t h = 0x9E3779B97F4A7C15ULL ^ length;
+                size_t i = 0;
+                for(; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
                 {
-                    uint32_t old = val;
-                    if(marking[i] != 0)
-                    {
-                        ++cnt;
-                        last = std::max(last, i);
-                        val = std::max(marking[i], val);
-                        if(old != 0 && marking[i] != old) allsame = false;
-                        ++active;
-                        sum += marking[i];
-                    }
+                    uint64_t k;
+                    memcpy(&k, data + i, sizeof(uint64_t));
+                    k *= 0x87c37b91114253d5ULL;
+                    k = (k << 31) | (k >> 33);
+                    h ^= k * 0x4cf5ad432745937fULL;
+                    h = ((h << 27) | (h >> 37)) * 5 + 0x52dce729;
                 }
+                if(i < length)
+                {
+                    uint64_t k = 0;
+                    memcpy(&k, data + i, length - i);
+                    h ^= k * 0x87c37b91114253d5ULL;
+                }
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdULL;
+                h ^= h >> 33;
+                h *= 0xc4ceb9fe1a85ec53ULL;
+                h ^= h >> 33;
+                return h;
+            }
+
+        protected:
+            void markingStats(const uint32_t* marking, MarkVal& sum, bool& allsame, uint32_t& val, uint32_t& active, uint32_t& last)
+            {
+                auto stats = Structures::markingStats(marking, _nplaces);
+                sum = stats.sum;
+                allsame = stats.allsame;
+                val = stats.max;
+                active = stats.active;
+                last = stats.last;
             }
         };
 
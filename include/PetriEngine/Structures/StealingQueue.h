@@ -0,0 +1,134 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STEALINGQUEUE_H
+#define STEALINGQUEUE_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "Queue.h"
+
+namespace PetriEngine {
+    namespace Structures {
+
+        /**
+         * Frontier shared by a number of workers. Every worker owns a local
+         * queue which only it pushes to; a worker running dry steals from the
+         * other workers. The locks are per worker, so workers only contend
+         * when stealing.
+         * pop returns EMPTY once no worker holds or is expanding a state.
+         */
+        class StealingQueue {
+        public:
+            StealingQueue(size_t seed, uint32_t workers);
+            virtual ~StealingQueue();
+
+            size_t pop(uint32_t worker);
+            void push(uint32_t worker, size_t id, PQL::DistanceContext* = nullptr,
+                const PQL::Condition* query = nullptr);
+            bool empty() const { return _pending == 0; }
+            // makes every subsequent pop return EMPTY, e.g. on early termination
+            void abort() { _aborted = true; }
+            uint32_t workers() const { return _workers; }
+            size_t steals() const { return _steals; }
+
+            static constexpr size_t EMPTY = Queue::EMPTY;
+        protected:
+            virtual void _push(uint32_t worker, size_t id, PQL::DistanceContext*,
+                const PQL::Condition* query) = 0;
+            // both are called with the lock of worker held
+            virtual size_t _pop(uint32_t worker) = 0;
+            virtual size_t _steal(uint32_t thief, uint32_t victim) = 0;
+            // choose whom to steal from, called without any locks held
+            virtual uint32_t _victim(uint32_t thief, uint32_t attempt);
+
+            std::mutex& lock(uint32_t worker) { return *_locks[worker]; }
+
+        private:
+            uint32_t _workers;
+            std::vector<std::unique_ptr<std::mutex>> _locks;
+            std::vector<uint8_t> _active;
+            std::atomic<size_t> _pending{0};
+            // states pushed and not yet expanded, popped ones count until the
+            // worker's next pop; one counter, so no state is missed between two reads
+            std::atomic<size_t> _unfinished{0};
+            std::atomic<size_t> _steals{0};
+            std::atomic<bool> _aborted{false};
+        };
+
+        class BFSStealingQueue : public StealingQueue {
+        public:
+            BFSStealingQueue(size_t seed, uint32_t workers);
+        protected:
+            void _push(uint32_t worker, size_t id, PQL::DistanceContext*,
+                const PQL::Condition* query) override;
+            size_t _pop(uint32_t worker) override;
+            size_t _steal(uint32_t thief, uint32_t victim) override;
+        private:
+            std::vector<std::deque<size_t>> _queues;
+        };
+
+        class DFSStealingQueue : public StealingQueue {
+        public:
+            DFSStealingQueue(size_t seed, uint32_t workers);
+        protected:
+            void _push(uint32_t worker, size_t id, PQL::DistanceContext*,
+                const PQL::Condition* query) override;
+            size_t _pop(uint32_t worker) override;
+            size_t _steal(uint32_t thief, uint32_t victim) override;
+        private:
+            std::vector<std::deque<uint32_t>> _stacks;
+        };
+
+        class RDFSStealingQueue : public StealingQueue {
+        public:
+            RDFSStealingQueue(size_t seed, uint32_t workers);
+        protected:
+            void _push(uint32_t worker, size_t id, PQL::DistanceContext*,
+                const PQL::Condition* query) override;
+            size_t _pop(uint32_t worker) override;
+            size_t _steal(uint32_t thief, uint32_t victim) override;
+        private:
+            std::vector<std::deque<uint32_t>> _stacks;
+            std::vector<std::vector<uint32_t>> _caches;
+            std::vector<std::default_random_engine> _rngs;
+        };
+
+        class HeuristicStealingQueue : public StealingQueue {
+        public:
+            using weighted_t = HeuristicQueue::weighted_t;
+            HeuristicStealingQueue(size_t seed, uint32_t workers);
+        protected:
+            void _push(uint32_t worker, size_t id, PQL::DistanceContext*,
+                const PQL::Condition* query) override;
+            size_t _pop(uint32_t worker) override;
+            size_t _steal(uint32_t thief, uint32_t victim) override;
+            uint32_t _victim(uint32_t thief, uint32_t attempt) override;
+        private:
+            std::vector<std::priority_queue<weighted_t>> _queues;
+            // best weight of every heap, read without locks when picking a victim
+            std::unique_ptr<std::atomic<uint32_t>[]> _best;
+        };
+    }
+}
+
+#endif /* STEALINGQUEUE_H */
@@ -21,6 +21,12 @@ enum class Strategy {
     DEFAULT
 };
 
+enum class StateStore {
+    PTrie,
+    Hash,
+    Bitstate
+};
+
 enum class TraceLevel {
     None,
     Transitions,
@@ -51,6 +57,15 @@ struct options_t {
     uint32_t siphontrapTimeout = 0;
     uint32_t siphonDepth = 0;
     uint32_t cores = 1;
+    // threads of the state-space exploration, the czero CTL and the cndfs LTL algorithms
+    uint32_t threads = 1;
+    StateStore statestore = StateStore::PTrie;
+    uint32_t hashsize = 22; // log2 of the number of slots in the hash state store
+    uint32_t bitstatesize = 30; // log2 of the number of bits in the bitstate store
+    uint32_t bitstatehashes = 3; // bits set per marking in the bitstate store
+    size_t memorylimit = 0; // in MB, 0 is unlimited
+    uint32_t tracecheckpoint = 1; // store every n-th marking of a trace in full
+    bool adaptiveencoding = false; // pack markings with learned per-place bit widths
     bool doVerification = true;
 
     TemporalLogic logic = TemporalLogic::CTL;
@@ -58,6 +73,11 @@ struct options_t {
     //CTL Specific options
     bool usedctl = false;
     CTL::CTLAlgorithmType ctlalgorithm = CTL::CZero;
+    size_t ctlsuccessorcache = 0; // markings whose successors are cached, 0 is disabled
+    uint32_t ctltimebudget = 0; // in seconds per CTL query, 0 is unlimited
+    size_t ctlmemorybudget = 0; // in MB of the dependency graph, 0 is unlimited
+    uint32_t ctlprogress = 0; // seconds between progress records, 0 is disabled
+    bool ctlbatch = false; // solve the CTL queries on one graph with shared subformulas
     bool tar = false;
     uint32_t binary_query_io = 0;
 
@@ -1,7 +1,9 @@
 #include "CTL/Algorithm/CertainZeroFPA.h"
 
 #include <cassert>
+#include <exception>
 #include <iostream>
+#include <thread>
 
 using namespace DependencyGraph;
 using namespace SearchStrategy;
@@ -9,9 +11,18 @@ using namespace SearchStrategy;
 bool Algorithm::CertainZeroFPA::search(DependencyGraph::BasicDependencyGraph &t_graph)
 {
     graph = &t_graph;
+    vertex = graph->initialConfiguration();
+    startBudget();
+    // already decided by an earlier search on the same graph
+    if(vertex->isDone()) return vertex->assignment == ONE;
 
+    if(_threads > 1)
+    {
+        auto workers = graph->prepareWorkers(_threads);
+        if(workers > 1)
+            return searchParallel(workers);
+    }
 
-    vertex = graph->initialConfiguration();
     {
         explore(vertex);
     }
@@ -21,14 +32,18 @@ bool Algorithm::CertainZeroFPA::search(DependencyGraph::BasicDependencyGraph &t_
     {
         while (auto e = strategy->popEdge(false)) 
         {
-            ++e->refcnt;
-            assert(e->refcnt >= 1);
-            checkEdge(e);
-            assert(e->refcnt >= -1);
-            if(e->refcnt > 0) --e->refcnt;
-            if(e->refcnt == 0) graph->release(e);            
+            processEdge(e);
             ++cnt;
-            if((cnt % 1000) == 0) strategy->trivialNegation();
+            if((cnt % 1000) == 0)
+            {
+                strategy->trivialNegation();
+                graph->collect();
+                if(!vertex->isDone() && !withinBudget(*graph))
+                {
+                    _exhausted = true;
+                    return false;
+                }
+            }
             if(vertex->isDone()) return vertex->assignment == ONE;
         }
         
@@ -45,6 +60,199 @@ bool Algorithm::CertainZeroFPA::search(DependencyGraph::BasicDependencyGraph &t_
     return vertex->assignment == ONE;
 }
 
+bool Algorithm::CertainZeroFPA::searchParallel(size_t workers)
+{
+    _parallel = true;
+    _stop = false;
+    _pending = std::vector<pending_t>(workers);
+    _queued = 0;
+    _outstanding = 0;
+    explore(vertex);
+    handOver(0);
+
+    // errors are rethrown in the calling thread
+    std::exception_ptr error;
+    auto worker = [&](size_t wid) {
+        try {
+            work(wid);
+        } catch(...) {
+            std::lock_guard<std::mutex> lk(_lock);
+            if(!error) error = std::current_exception();
+            _stop = true;
+            _cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < workers; ++i)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for(auto& t : threads)
+        t.join();
+    _parallel = false;
+    // configurations left pending stay ZERO, as the ones left waiting by the sequential search
+    _pending.clear();
+    _explored.clear();
+    if(error)
+        std::rethrow_exception(error);
+
+    return vertex->assignment == ONE;
+}
+
+void Algorithm::CertainZeroFPA::work(size_t worker)
+{
+    // edges processed per turn on the lock, workers computing successors add theirs in between
+    constexpr size_t turn = 64;
+    size_t cnt = 0;
+    while(!_stop && !vertex->isDone())
+    {
+        Configuration* c = nullptr;
+        std::vector<Edge*> succs;
+        {
+            std::shared_lock<std::shared_mutex> computing(_computing);
+            c = takePending(worker);
+            if(c != nullptr)
+            {
+                succs = graph->successors(c, worker);
+                // drop the targets decided meanwhile before taking the lock
+                bool allOne, hasCZero;
+                Configuration* lastUndecided;
+                for(Edge* e : succs)
+                    scanTargets(e, allOne, hasCZero, lastUndecided);
+            }
+        }
+
+        std::unique_lock<std::mutex> lk(_lock);
+        if(c != nullptr)
+        {
+            --_outstanding;
+            if(_stop || vertex->isDone())
+            {
+                releaseSuccessors(succs);
+                break;
+            }
+            addSuccessors(c, std::move(succs));
+            handOver(worker);
+            _cv.notify_all();
+            continue;
+        }
+        if(_stop || vertex->isDone())
+            break;
+
+        size_t processed = 0;
+        while(processed < turn && _explored.empty())
+        {
+            auto e = strategy->popEdge(false);
+            if(e == nullptr)
+                break;
+            processEdge(e);
+            ++processed;
+            ++cnt;
+            if((cnt % 1000) == 0)
+            {
+                strategy->trivialNegation();
+                {
+                    // configurations are looked up without the lock while successors are computed
+                    std::unique_lock<std::shared_mutex> quiet(_computing, std::try_to_lock);
+                    if(quiet.owns_lock()) graph->collect();
+                }
+                if(!vertex->isDone() && !withinBudget(*graph))
+                {
+                    _exhausted = true;
+                    _stop = true;
+                    break;
+                }
+            }
+            if(vertex->isDone())
+                break;
+        }
+        handOver(worker);
+        if(processed > 0)
+            continue;
+
+        if(_outstanding > 0)
+        {
+            // the successors being computed may give more work
+            if(_queued == 0)
+                _cv.wait(lk);
+            continue;
+        }
+
+        // nothing is waiting or being explored; here the sequential search releases negation edges
+        if(strategy->empty())
+            break;
+        if(!strategy->trivialNegation())
+        {
+            cnt = 0;
+            strategy->releaseNegationEdges(strategy->maxDistance());
+        }
+    }
+    std::lock_guard<std::mutex> lk(_lock);
+    _stop = true;
+    _cv.notify_all();
+}
+
+DependencyGraph::Configuration* Algorithm::CertainZeroFPA::takePending(size_t worker)
+{
+    auto n = _pending.size();
+    for(size_t i = 0; i < n && _queued > 0; ++i)
+    {
+        auto& pending = _pending[(worker + i) % n];
+        std::lock_guard<std::mutex> lk(pending.lock);
+        if(pending.configs.empty())
+            continue;
+        Configuration* c;
+        // the own list depth first, the others are stolen from breadth first
+        if(i == 0)
+        {
+            c = pending.configs.back();
+            pending.configs.pop_back();
+        }
+        else
+        {
+            c = pending.configs.front();
+            pending.configs.pop_front();
+        }
+        --_queued;
+        return c;
+    }
+    return nullptr;
+}
+
+void Algorithm::CertainZeroFPA::handOver(size_t worker)
+{
+    if(_explored.empty())
+        return;
+    _queued += _explored.size();
+    _outstanding += _explored.size();
+    {
+        auto& pending = _pending[worker];
+        std::lock_guard<std::mutex> lk(pending.lock);
+        pending.configs.insert(pending.configs.end(), _explored.begin(), _explored.end());
+    }
+    _explored.clear();
+    _cv.notify_all();
+}
+
+void Algorithm::CertainZeroFPA::releaseSuccessors(std::vector<Edge*>& succs)
+{
+    for(Edge *e : succs){
+        assert(e->refcnt <= 1);
+        if(e->refcnt >= 1) --e->refcnt;
+        if(e->refcnt == 0) graph->release(e);
+    }
+}
+
+void Algorithm::CertainZeroFPA::processEdge(Edge* e)
+{
+    ++e->refcnt;
+    assert(e->refcnt >= 1);
+    checkEdge(e);
+    assert(e->refcnt >= -1);
+    if(e->refcnt > 0) --e->refcnt;
+    if(e->refcnt == 0) graph->release(e);
+}
+
 void Algorithm::CertainZeroFPA::checkEdge(Edge* e, bool only_assign)
 {
     if(e->handled) return;
@@ -68,37 +276,10 @@ void Algorithm::CertainZeroFPA::checkEdge(Edge* e, bool only_assign)
         if(!any && e->source != vertex) return;
     }*/
     
-    bool allOne = true;
-    bool hasCZero = false;
-    //auto pre_empty = e->targets.empty();
-    Configuration *lastUndecided = nullptr;
-    {
-        auto it = e->targets.begin();
-        auto pit = e->targets.before_begin();
-        while(it != e->targets.end())
-        {
-            if ((*it)->assignment == ONE)
-            {
-                e->targets.erase_after(pit);
-                it = pit;
-            }
-            else
-            {
-                allOne = false;
-                if ((*it)->assignment == CZERO) {
-                    hasCZero = true;
-                    //assert(e->assignment == CZERO || only_assign);
-                    break;
-                }
-                else if(lastUndecided == nullptr)
-                {
-                    lastUndecided = *it;
-                }
-            }
-            pit = it;
-            ++it;
-        }
-    }
+    bool allOne;
+    bool hasCZero;
+    Configuration *lastUndecided;
+    scanTargets(e, allOne, hasCZero, lastUndecided);
     /*if(e->targets.empty())
     {
         assert(e->assignment == ONE || e->children == 0);
@@ -167,16 +348,61 @@ void Algorithm::CertainZeroFPA::checkEdge(Edge* e, bool only_assign)
     if(e->refcnt == 0) graph->release(e);
 }
 
+void Algorithm::CertainZeroFPA::scanTargets(Edge* e, bool& allOne, bool& hasCZero, Configuration*& lastUndecided)
+{
+    allOne = true;
+    hasCZero = false;
+    lastUndecided = nullptr;
+    // targets assigned ONE are dropped, the others are moved up in place
+    auto& targets = e->targets;
+    uint32_t keep = 0;
+    uint32_t i = 0;
+    for(; i < targets.size(); ++i)
+    {
+        Configuration* t = targets[i];
+        int8_t assignment = t->assignment;
+        if (assignment == ONE)
+        {
+            graph->release(t);
+            continue;
+        }
+        targets[keep++] = t;
+        allOne = false;
+        if (assignment == CZERO) {
+            hasCZero = true;
+            ++i;
+            break;
+        }
+        else if(lastUndecided == nullptr)
+        {
+            lastUndecided = t;
+        }
+    }
+    for(; i < targets.size(); ++i)
+        targets[keep++] = targets[i];
+    targets.truncate(keep);
+}
+
 void Algorithm::CertainZeroFPA::finalAssign(DependencyGraph::Edge *e, DependencyGraph::Assignment a)
 {
-    finalAssign(e->source, a);
+    auto c = e->source;
+    // a CZERO hyper edge is only the last of the failed successors
+    bool justifies = a == ONE || e->is_negated;
+    // e may be released while the dependencies of c are pushed
+    auto index = e->index;
+    if(finalAssign(c, a) && justifies)
+        c->witness = index + 1;
 }
 
-void Algorithm::CertainZeroFPA::finalAssign(DependencyGraph::Configuration *c, DependencyGraph::Assignment a)
+bool Algorithm::CertainZeroFPA::finalAssign(DependencyGraph::Configuration *c, DependencyGraph::Assignment a)
 {
     assert(a == ONE || a == CZERO);
 
-    c->assignment = a;
+    // the assignment is read without the lock by the parallel search, it is final once set
+    int8_t old = c->assignment;
+    do {
+        if(old == ONE || old == CZERO) return false;
+    } while(!c->assignment.compare_exchange_weak(old, a));
     c->nsuccs = 0;
     for (DependencyGraph::Edge *e : c->dependency_set) {
         if(!e->source->isDone()) {
@@ -206,14 +432,26 @@ void Algorithm::CertainZeroFPA::finalAssign(DependencyGraph::Configuration *c, D
     }
     
     c->dependency_set.clear();
+    c->dependency_set.shrink_to_fit();
+    return true;
 }
 
 void Algorithm::CertainZeroFPA::explore(Configuration *c)
 {
     c->assignment = ZERO;
 
+    if(_parallel)
+    {
+        // a worker computes the successors without holding the lock, see work
+        _explored.push_back(c);
+        return;
+    }
+    addSuccessors(c, graph->successors(c));
+}
+
+void Algorithm::CertainZeroFPA::addSuccessors(Configuration *c, std::vector<Edge*> succs)
+{
     {
-        auto succs = graph->successors(c);
         c->nsuccs = succs.size();
 
         _exploredConfigurations += 1;
@@ -226,21 +464,13 @@ void Algorithm::CertainZeroFPA::explore(Configuration *c)
             checkEdge(succs[i], true);
             if(c->isDone()) 
             {
-                for(Edge *e : succs){
-                    assert(e->refcnt <= 1);
-                    if(e->refcnt >= 1) --e->refcnt;
-                    if(e->refcnt == 0) graph->release(e);
-                }
+                releaseSuccessors(succs);
                 return;
             }
         }
 
         if (c->nsuccs == 0) {
-            for(Edge *e : succs){
-                assert(e->refcnt <= 1);
-                if(e->refcnt >= 1) --e->refcnt;
-                if(e->refcnt == 0) graph->release(e);
-            }
+            releaseSuccessors(succs);
             finalAssign(c, CZERO);
             return;
         }
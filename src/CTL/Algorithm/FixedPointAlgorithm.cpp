@@ -3,6 +3,7 @@
 #include "CTL/SearchStrategy/DFSSearch.h"
 #include "CTL/SearchStrategy/RDFSSearch.h"
 #include "CTL/SearchStrategy/HeuristicSearch.h"
+#include <algorithm>
 
 namespace Algorithm {
     FixedPointAlgorithm::FixedPointAlgorithm(Strategy type) {
@@ -27,5 +28,40 @@ namespace Algorithm {
         }
     }
 
+    void FixedPointAlgorithm::startBudget() {
+        _exhausted = false;
+        _start = std::chrono::high_resolution_clock::now();
+        _lastProgress = 0;
+        _nextMemoryCheck = 0;
+    }
+
+    bool FixedPointAlgorithm::withinBudget(DependencyGraph::BasicDependencyGraph& graph) {
+        auto now = std::chrono::high_resolution_clock::now();
+        double elapsed = std::chrono::duration<double>(now - _start).count();
+        if(_progressInterval > 0 && elapsed - _lastProgress >= _progressInterval)
+        {
+            _lastProgress = elapsed;
+            auto edges = _processedEdges + _processedNegationEdges;
+            *_progressOut << "PROGRESS time=" << elapsed
+                          << " configurations=" << _exploredConfigurations
+                          << " edges=" << edges
+                          << " queue=" << strategy->size()
+                          << " edges/s=" << (elapsed > 0 ? size_t(edges / elapsed) : 0)
+                          << std::endl;
+        }
+        if(_timeBudget > 0 && elapsed >= _timeBudget)
+            return false;
+        if(_memoryBudget > 0 && elapsed >= _nextMemoryCheck)
+        {
+            auto usage = graph.memoryUsage();
+            if(usage >= _memoryBudget)
+                return false;
+            // spend at most a tenth of the time measuring
+            double spent = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - now).count();
+            _nextMemoryCheck = elapsed + std::max(0.1, 10 * spent);
+        }
+        return true;
+    }
+
 
 }
@@ -11,8 +11,12 @@ bool Algorithm::LocalFPA::search(DependencyGraph::BasicDependencyGraph &t_graph)
     graph = &t_graph;
 
     Configuration *v = graph->initialConfiguration();
+    startBudget();
+    // already decided by an earlier search on the same graph
+    if(v->isDone()) return v->assignment == ONE;
     explore(v);
 
+    size_t cnt = 0;
     while (!strategy->empty())
     {
         while (auto e = strategy->popEdge()) {
@@ -43,6 +47,7 @@ bool Algorithm::LocalFPA::search(DependencyGraph::BasicDependencyGraph &t_graph)
                     strategy->pushNegation(e);
                 }
                 else{
+                    e->source->witness = e->index + 1;
                     finalAssign(e->source, ONE);
                 }
 
@@ -50,6 +55,7 @@ bool Algorithm::LocalFPA::search(DependencyGraph::BasicDependencyGraph &t_graph)
                 _processedEdges += 1;
                 //Process hyper edge
                 if (allOne) {
+                    e->source->witness = e->index + 1;
                     finalAssign(e->source, ONE);
                 } else {
                     addDependency(e, lastUndecided);
@@ -60,6 +66,15 @@ bool Algorithm::LocalFPA::search(DependencyGraph::BasicDependencyGraph &t_graph)
             }
             e->processed = true;
             if(e->refcnt == 0) graph->release(e);
+            if((++cnt % 1000) == 0)
+            {
+                graph->collect();
+                if(v->assignment != ONE && !withinBudget(*graph))
+                {
+                    _exhausted = true;
+                    return false;
+                }
+            }
         }
         if(!strategy->trivialNegation())
         {
@@ -89,6 +104,7 @@ void Algorithm::LocalFPA::finalAssign(DependencyGraph::Configuration *c, Depende
     }
 
     c->dependency_set.clear();
+    c->dependency_set.shrink_to_fit();
 }
 
 void Algorithm::LocalFPA::explore(DependencyGraph::Configuration *c)
@@ -16,8 +16,14 @@
 #include "PetriEngine/PQL/PredicateCheckers.h"
 #include "LTL/LTLSearch.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using namespace CTL;
@@ -27,7 +33,7 @@ using namespace PetriEngine::Reachability;
 using namespace PetriNets;
 
 ReturnValue getAlgorithm(std::shared_ptr<Algorithm::FixedPointAlgorithm>& algorithm,
-                         CTLAlgorithmType algorithmtype, Strategy search)
+                         CTLAlgorithmType algorithmtype, Strategy search, uint32_t threads)
 {
     switch(algorithmtype)
     {
@@ -35,7 +41,7 @@ ReturnValue getAlgorithm(std::shared_ptr<Algorithm::FixedPointAlgorithm>& algori
             algorithm = std::make_shared<Algorithm::LocalFPA>(search);
             break;
         case CTLAlgorithmType::CZero:
-            algorithm = std::make_shared<Algorithm::CertainZeroFPA>(search);
+            algorithm = std::make_shared<Algorithm::CertainZeroFPA>(search, threads);
             break;
         default:
             throw base_error("Unknown or unsupported algorithm");
@@ -43,25 +49,68 @@ ReturnValue getAlgorithm(std::shared_ptr<Algorithm::FixedPointAlgorithm>& algori
     return ReturnValue::ContinueCode;
 }
 
-bool singleSolve(Condition* query, PetriNet* net,
+/**
+ * Keeps the witness of query if its answer decides result.query, that is if
+ * query is result.query below some negations; the witness of a negated
+ * query is the counterexample of the query.
+ */
+void recordWitness(Condition* query, OnTheFlyDG& graph, CTLResult& result)
+{
+    Condition* top = result.query;
+    while(top != query)
+    {
+        auto neg = dynamic_cast<NotCondition*>(top);
+        if(neg == nullptr) return;
+        top = (*neg)[0].get();
+    }
+    std::stringstream ss;
+    if(graph.printWitness(ss))
+        result.trace = ss.str();
+}
+
+bool singleSolve(Condition* query, OnTheFlyDG& graph,
                  CTLAlgorithmType algorithmtype,
-                 Strategy strategytype, bool partial_order, CTLResult& result);
+                 Strategy strategytype, CTLResult& result, const options_t& options);
 
-bool singleSolve(const Condition_ptr& query, PetriNet* net,
+bool singleSolve(const Condition_ptr& query, OnTheFlyDG& graph,
                  CTLAlgorithmType algorithmtype,
-                 Strategy strategytype, bool partial_order, CTLResult& result)
+                 Strategy strategytype, CTLResult& result, const options_t& options)
 {
-    return singleSolve(query.get(), net, algorithmtype, strategytype, partial_order, result);
+    return singleSolve(query.get(), graph, algorithmtype, strategytype, result, options);
 }
 
-bool singleSolve(Condition* query, PetriNet* net,
+bool singleSolve(Condition* query, OnTheFlyDG& graph,
                  CTLAlgorithmType algorithmtype,
-                 Strategy strategytype, bool partial_order, CTLResult& result)
+                 Strategy strategytype, CTLResult& result, const options_t& options)
 {
-    OnTheFlyDG graph(net, partial_order);
+    // the answer is unknown once a search of the query ran out of budget
+    if(result.exhausted)
+        return false;
+    double remaining = 0;
+    if(options.ctltimebudget > 0)
+    {
+        std::chrono::duration<double> spent = std::chrono::steady_clock::now() - result.started;
+        remaining = options.ctltimebudget - spent.count();
+        if(remaining <= 0)
+        {
+            result.exhausted = true;
+            return false;
+        }
+    }
+    // the graph is shared by all queries, only what this query adds is counted
+    auto configurations = graph.configurationCount();
+    auto markings = graph.markingCount();
+    auto reclaimed = graph.reclaimedCount();
+    auto hits = graph.successorCacheHits();
+    auto misses = graph.successorCacheMisses();
+    auto reduced = graph.reducedExpansions();
     graph.setQuery(query);
     std::shared_ptr<Algorithm::FixedPointAlgorithm> alg = nullptr;
-    getAlgorithm(alg, algorithmtype,  strategytype);
+    getAlgorithm(alg, algorithmtype,  strategytype, options.threads);
+    alg->setBudget(remaining, options.ctlmemorybudget * 1024 * 1024);
+    // std::cout carries the answers
+    if(options.ctlprogress > 0)
+        alg->setProgress(options.ctlprogress, std::cerr);
 
     stopwatch timer;
     timer.start();
@@ -69,18 +118,30 @@ bool singleSolve(Condition* query, PetriNet* net,
     timer.stop();
 
     result.duration += timer.duration();
-    result.numberOfConfigurations += graph.configurationCount();
-    result.numberOfMarkings += graph.markingCount();
+    result.numberOfConfigurations += graph.configurationCount() - configurations;
+    result.numberOfMarkings += graph.markingCount() - markings;
     result.processedEdges += alg->processedEdges();
     result.processedNegationEdges += alg->processedNegationEdges();
     result.exploredConfigurations += alg->exploredConfigurations();
     result.numberOfEdges += alg->numberOfEdges();
+    result.reclaimedConfigurations += graph.reclaimedCount() - reclaimed;
+    result.allocatedConfigurations = graph.allocatedConfigurationCount();
+    result.allocatedEdges = graph.edgeCount();
+    result.configurationBytes = graph.configurationBytes();
+    result.edgeBytes = graph.edgeBytes();
+    result.successorCacheHits += graph.successorCacheHits() - hits;
+    result.successorCacheMisses += graph.successorCacheMisses() - misses;
+    result.reducedExpansions += graph.reducedExpansions() - reduced;
+    // the partial assignment stays in the graph for the later searches
+    result.exhausted |= alg->exhausted();
+    if(graph.recordsWitnesses() && !alg->exhausted())
+        recordWitness(query, graph, result);
     return res;
 }
 
 bool recursiveSolve(const Condition_ptr& query, PetriNet* net,
                     CTLAlgorithmType algorithmtype,
-                    Strategy strategytype, bool partial_order, CTLResult& result, options_t& options);
+                    Strategy strategytype, OnTheFlyDG& graph, CTLResult& result, options_t& options);
 
 class ResultHandler : public AbstractHandler {
     private:
@@ -117,7 +178,7 @@ class ResultHandler : public AbstractHandler {
 
 bool solveLogicalCondition(LogicalCondition* query, bool is_conj, PetriNet* net,
                            CTLAlgorithmType algorithmtype,
-                           Strategy strategytype, bool partial_order, CTLResult& result, options_t& options)
+                           Strategy strategytype, OnTheFlyDG& graph, CTLResult& result, options_t& options)
 {
     std::vector<int8_t> state(query->size(), 0);
     std::vector<int8_t> lstate;
@@ -172,7 +233,11 @@ bool solveLogicalCondition(LogicalCondition* query, bool is_conj, PetriNet* net,
     for(size_t i = 0; i < query->size(); ++i) {
         if (state[i] == 0)
         {
-            if(recursiveSolve((*query)[i], net, algorithmtype, strategytype, partial_order, result, options) xor is_conj)
+            bool res = recursiveSolve((*query)[i], net, algorithmtype, strategytype, graph, result, options);
+            // the remaining operands are not searched once the budget is used up
+            if(result.exhausted)
+                return false;
+            if(res xor is_conj)
             {
                 return !is_conj;
             }
@@ -200,30 +265,30 @@ public:
 
 bool recursiveSolve(Condition* query, PetriEngine::PetriNet* net,
                     CTL::CTLAlgorithmType algorithmtype,
-                    Strategy strategytype, bool partial_order, CTLResult& result, options_t& options);
+                    Strategy strategytype, OnTheFlyDG& graph, CTLResult& result, options_t& options);
 
 bool recursiveSolve(const Condition_ptr& query, PetriEngine::PetriNet* net,
                     CTL::CTLAlgorithmType algorithmtype,
-                    Strategy strategytype, bool partial_order, CTLResult& result, options_t& options)
+                    Strategy strategytype, OnTheFlyDG& graph, CTLResult& result, options_t& options)
 {
-    return recursiveSolve(query.get(), net, algorithmtype, strategytype, partial_order, result, options);
+    return recursiveSolve(query.get(), net, algorithmtype, strategytype, graph, result, options);
 }
 
 bool recursiveSolve(Condition* query, PetriEngine::PetriNet* net,
                     CTL::CTLAlgorithmType algorithmtype,
-                    Strategy strategytype, bool partial_order, CTLResult& result, options_t& options)
+                    Strategy strategytype, OnTheFlyDG& graph, CTLResult& result, options_t& options)
 {
     if(auto q = dynamic_cast<NotCondition*>(query))
     {
-        return ! recursiveSolve((*q)[0], net, algorithmtype, strategytype, partial_order, result, options);
+        return ! recursiveSolve((*q)[0], net, algorithmtype, strategytype, graph, result, options);
     }
     else if(auto q = dynamic_cast<AndCondition*>(query))
     {
-        return solveLogicalCondition(q, true, net, algorithmtype, strategytype, partial_order, result, options);
+        return solveLogicalCondition(q, true, net, algorithmtype, strategytype, graph, result, options);
     }
     else if(auto q = dynamic_cast<OrCondition*>(query))
     {
-        return solveLogicalCondition(q, false, net, algorithmtype, strategytype, partial_order, result, options);
+        return solveLogicalCondition(q, false, net, algorithmtype, strategytype, graph, result, options);
     }
     else if(PetriEngine::PQL::isReachability(query))
     {
@@ -282,10 +347,183 @@ bool recursiveSolve(Condition* query, PetriEngine::PetriNet* net,
     }
     //else
     {
-        return singleSolve(query, net, algorithmtype, strategytype, partial_order, result);
+        return singleSolve(query, graph, algorithmtype, strategytype, result, options);
     }
 }
 
+/**
+ * Hash-conses the subformulas of a batch of queries. Structurally equal
+ * subformulas become a single object, and as the configurations of the
+ * dependency graph are keyed by marking and subformula, their final
+ * assignments are computed once for all the queries containing them.
+ */
+class SubformulaTable {
+public:
+    Condition_ptr intern(const Condition_ptr& cond)
+    {
+        std::stringstream key;
+        std::vector<Condition_ptr> ops;
+        if(!isTemporal(cond))
+        {
+            // atomic propositions are compared by their text
+            key << "P ";
+            cond->toString(key);
+        }
+        else if(!operands(cond.get(), ops))
+        {
+            // not handled by the dependency graph, kept as is
+            key << "U " << cond.get();
+        }
+        else
+        {
+            for(auto& op : ops)
+                op = intern(op);
+            std::vector<Condition*> keys;
+            for(auto& op : ops)
+                keys.push_back(op.get());
+            if(dynamic_cast<LogicalCondition*>(cond.get()))
+                std::sort(keys.begin(), keys.end());
+            auto& node = *cond;
+            key << typeid(node).name() << (cond->isInvariant() ? " I" : "");
+            for(auto k : keys)
+                key << " " << k;
+        }
+        auto [it, fresh] = _table.emplace(key.str(), nullptr);
+        if(!fresh)
+        {
+            ++_shared;
+            return it->second;
+        }
+        it->second = rebuild(cond, ops);
+        return it->second;
+    }
+
+    size_t size() const { return _table.size(); }
+    // subformulas replaced by an equal one met before
+    size_t shared() const { return _shared; }
+
+private:
+    // the operands of the connectives the dependency graph expands
+    static bool operands(Condition* cond, std::vector<Condition_ptr>& ops)
+    {
+        if(auto q = dynamic_cast<NotCondition*>(cond))
+            ops.push_back((*q)[0]);
+        else if(auto q = dynamic_cast<LogicalCondition*>(cond))
+            ops.assign(q->begin(), q->end());
+        else if(dynamic_cast<EUCondition*>(cond) || dynamic_cast<AUCondition*>(cond))
+        {
+            auto q = static_cast<UntilCondition*>(cond);
+            ops.push_back((*q)[0]);
+            ops.push_back((*q)[1]);
+        }
+        else if(dynamic_cast<EFCondition*>(cond) || dynamic_cast<EGCondition*>(cond) ||
+                dynamic_cast<EXCondition*>(cond) || dynamic_cast<AFCondition*>(cond) ||
+                dynamic_cast<AGCondition*>(cond) || dynamic_cast<AXCondition*>(cond))
+            ops.push_back((*static_cast<SimpleQuantifierCondition*>(cond))[0]);
+        else
+            return false;
+        return true;
+    }
+
+    static Condition_ptr rebuild(const Condition_ptr& cond, std::vector<Condition_ptr>& ops)
+    {
+        auto* c = cond.get();
+        bool same = true;
+        for(size_t i = 0; i < ops.size(); ++i)
+            same &= ops[i].get() == operand(c, i);
+        if(same) return cond;
+
+        Condition_ptr res;
+        if(dynamic_cast<NotCondition*>(c)) res = std::make_shared<NotCondition>(ops[0]);
+        else if(dynamic_cast<AndCondition*>(c)) res = std::make_shared<AndCondition>(std::move(ops));
+        else if(dynamic_cast<OrCondition*>(c)) res = std::make_shared<OrCondition>(std::move(ops));
+        else if(dynamic_cast<EUCondition*>(c)) res = std::make_shared<EUCondition>(ops[0], ops[1]);
+        else if(dynamic_cast<AUCondition*>(c)) res = std::make_shared<AUCondition>(ops[0], ops[1]);
+        else if(dynamic_cast<EFCondition*>(c)) res = std::make_shared<EFCondition>(ops[0]);
+        else if(dynamic_cast<EGCondition*>(c)) res = std::make_shared<EGCondition>(ops[0]);
+        else if(dynamic_cast<EXCondition*>(c)) res = std::make_shared<EXCondition>(ops[0]);
+        else if(dynamic_cast<AFCondition*>(c)) res = std::make_shared<AFCondition>(ops[0]);
+        else if(dynamic_cast<AGCondition*>(c)) res = std::make_shared<AGCondition>(ops[0]);
+        else if(dynamic_cast<AXCondition*>(c)) res = std::make_shared<AXCondition>(ops[0]);
+        else throw base_error("Unexpected subformula while sharing CTL queries");
+        res->setInvariant(c->isInvariant());
+        res->setSatisfied(c->getSatisfied());
+        return res;
+    }
+
+    static Condition* operand(Condition* cond, size_t i)
+    {
+        if(auto q = dynamic_cast<NotCondition*>(cond))
+            return (*q)[i].get();
+        if(auto q = dynamic_cast<LogicalCondition*>(cond))
+            return (*q)[i].get();
+        return (*static_cast<QuantifierCondition*>(cond))[i].get();
+    }
+
+    std::unordered_map<std::string, Condition_ptr> _table;
+    size_t _shared = 0;
+};
+
+// the temporal subformulas of cond, which are the ones owning configurations
+void temporalSubformulas(Condition* cond, std::unordered_set<Condition*>& subs)
+{
+    if(!isTemporal(cond) || !subs.insert(cond).second)
+        return;
+    if(auto q = dynamic_cast<NotCondition*>(cond))
+        temporalSubformulas((*q)[0].get(), subs);
+    else if(auto q = dynamic_cast<LogicalCondition*>(cond))
+    {
+        for(auto& c : *q)
+            temporalSubformulas(c.get(), subs);
+    }
+    else if(auto q = dynamic_cast<UntilCondition*>(cond))
+    {
+        temporalSubformulas((*q)[0].get(), subs);
+        temporalSubformulas((*q)[1].get(), subs);
+    }
+    else if(auto q = dynamic_cast<SimpleQuantifierCondition*>(cond))
+        temporalSubformulas((*q)[0].get(), subs);
+}
+
+/**
+ * Orders the queries of a batch for reuse: the next query is the one with
+ * the most temporal subformulas shared with the queries already solved,
+ * and among those the smallest, so a subformula is preferably solved as a
+ * query of its own before the larger queries containing it.
+ */
+std::vector<size_t> batchOrder(const std::vector<Condition_ptr>& queries, const std::vector<size_t>& querynumbers)
+{
+    std::vector<std::unordered_set<Condition*>> subs(querynumbers.size());
+    for(size_t i = 0; i < querynumbers.size(); ++i)
+        temporalSubformulas(queries[querynumbers[i]].get(), subs[i]);
+    std::unordered_set<Condition*> solved;
+    std::vector<bool> done(querynumbers.size(), false);
+    std::vector<size_t> order;
+    while(order.size() < querynumbers.size())
+    {
+        size_t best = 0;
+        size_t bestShared = 0;
+        bool found = false;
+        for(size_t i = 0; i < querynumbers.size(); ++i)
+        {
+            if(done[i]) continue;
+            size_t shared = 0;
+            for(auto s : subs[i])
+                shared += solved.count(s);
+            if(!found || shared > bestShared ||
+               (shared == bestShared && subs[i].size() < subs[best].size()))
+            {
+                best = i;
+                bestShared = shared;
+                found = true;
+            }
+        }
+        done[best] = true;
+        solved.insert(subs[best].begin(), subs[best].end());
+        order.push_back(querynumbers[best]);
+    }
+    return order;
+}
 
 ReturnValue CTLMain(PetriNet* net,
                     CTLAlgorithmType algorithmtype,
@@ -295,15 +533,37 @@ ReturnValue CTLMain(PetriNet* net,
                     const std::vector<std::string>& querynames,
                     const std::vector<std::shared_ptr<Condition>>& queries,
                     const std::vector<size_t>& querynumbers,
-                    options_t& options
+                    options_t& options,
+                    const PetriEngine::Reducer* reducer
         )
 {
-    for(auto qnum : querynumbers){
-        CTLResult result(queries[qnum]);
+    // the shared queries must outlive the configurations pointing into them
+    std::vector<Condition_ptr> batch;
+    // markings and final assignments are shared by the queries
+    OnTheFlyDG graph(net, partial_order, algorithmtype == CTLAlgorithmType::CZero ? options.threads : 1);
+    if(partial_order && options.threads > 1 && algorithmtype == CTLAlgorithmType::CZero)
+        std::cerr << "Warning: stubborn sets are not supported with --threads above 1, using full expansion" << std::endl;
+    graph.setSuccessorCache(options.ctlsuccessorcache);
+    graph.setDistanceHeuristic(strategytype == Strategy::HEUR);
+    if(options.trace != TraceLevel::None)
+        graph.recordWitnesses(reducer);
+    std::vector<size_t> order = querynumbers;
+    if(options.ctlbatch)
+    {
+        SubformulaTable table;
+        batch.resize(queries.size());
+        for(auto qnum : querynumbers)
+            batch[qnum] = table.intern(queries[qnum]);
+        order = batchOrder(batch, querynumbers);
+        if(printstatistics)
+            std::cout << "Shared CTL subformulas: " << table.shared() << " of "
+                      << table.shared() + table.size() << "\n";
+    }
+    for(auto qnum : order){
+        CTLResult result(options.ctlbatch ? batch[qnum] : queries[qnum]);
         bool solved = false;
 
         {
-            OnTheFlyDG graph(net, partial_order);
             graph.setQuery(result.query);
             switch (graph.initialEval()) {
                 case Condition::Result::RFALSE:
@@ -328,10 +588,12 @@ ReturnValue CTLMain(PetriNet* net,
         if(!solved)
         {
             if(options.strategy == Strategy::BFS || options.strategy == Strategy::RDFS)
-                result.result = singleSolve(result.query, net, algorithmtype, options.strategy, options.stubbornreduction, result);
+                result.result = singleSolve(result.query, graph, algorithmtype, options.strategy, result, options);
             else
-                result.result = recursiveSolve(result.query, net, algorithmtype, strategytype, partial_order, result, options);
+                result.result = recursiveSolve(result.query, net, algorithmtype, strategytype, graph, result, options);
         }
+        else if(graph.recordsWitnesses())
+            recordWitness(result.query, graph, result);
         result.print(querynames[qnum], printstatistics, qnum, options, std::cout);
     }
     return ReturnValue::SuccessCode;
@@ -1,22 +1,39 @@
 #include "CTL/CTLResult.h"
 #include <iomanip>
+#include <iostream>
 
 void CTLResult::print(const std::string& qname, bool statisticslevel, size_t index, options_t& options, std::ostream& out) const {
 
     const static std::string techniques = "TECHNIQUES COLLATERAL_PROCESSING EXPLICIT STATE_COMPRESSION SAT_SMT ";
 
     out << "\n";
-    out << "FORMULA "
-         << qname
-         << " " << (result ? "TRUE" : "FALSE") << " "
-         << techniques
-         << (options.isCPN ? "UNFOLDING_TO_PT " : "")
-         << (options.stubbornreduction ? "STUBBORN_SETS " : "")
-         << (options.ctlalgorithm == CTL::CZero ? "CTL_CZERO " : "")
-         << (options.ctlalgorithm == CTL::Local ? "CTL_LOCAL " : "")
-            << "\n\n";
-    out << "Query index " << index << " was solved" << "\n";
-    out << "Query is" << (result ? "" : " NOT") << " satisfied." << "\n";
+    if(exhausted)
+    {
+        // the undecided search counted as false in the connectives above it
+        out << "FORMULA " << qname << " CANNOT_COMPUTE" << "\n\n";
+        out << "Query index " << index << " ran out of the CTL budget" << "\n";
+    }
+    else
+    {
+        out << "FORMULA "
+             << qname
+             << " " << (result ? "TRUE" : "FALSE") << " "
+             << techniques
+             << (options.isCPN ? "UNFOLDING_TO_PT " : "")
+             << (options.stubbornreduction ? "STUBBORN_SETS " : "")
+             << (options.ctlalgorithm == CTL::CZero ? "CTL_CZERO " : "")
+             << (options.ctlalgorithm == CTL::Local ? "CTL_LOCAL " : "")
+                << "\n\n";
+        out << "Query index " << index << " was solved" << "\n";
+        out << "Query is" << (result ? "" : " NOT") << " satisfied." << "\n";
+    }
+    if(options.trace != TraceLevel::None && !exhausted)
+    {
+        if(trace.empty())
+            out << "No trace could be generated" << "\n";
+        else
+            std::cerr << "Trace:\n" << trace << std::endl;
+    }
 
     if(statisticslevel){
         out << "\n";
@@ -28,6 +45,16 @@ void CTLResult::print(const std::string& qname, bool statisticslevel, size_t ind
         out << "	Processed Edges   : " << processedEdges << "\n";
         out << "	Processed N. Edges: " << processedNegationEdges << "\n";
         out << "	Explored Configs  : " << exploredConfigurations << "\n";
+        out << "	Reclaimed Configs : " << reclaimedConfigurations << "\n";
+        out << "	Bytes per config  : " << (allocatedConfigurations ? configurationBytes / allocatedConfigurations : 0) << "\n";
+        out << "	Bytes per edge    : " << (allocatedEdges ? edgeBytes / allocatedEdges : 0) << "\n";
+        if(options.stubbornreduction)
+            out << "	Reduced Expansions: " << reducedExpansions << "\n";
+        if(options.ctlsuccessorcache > 0)
+        {
+            out << "	Successor Hits    : " << successorCacheHits << "\n";
+            out << "	Successor Misses  : " << successorCacheMisses << "\n";
+        }
     }
     out << std::endl;
 }
\ No newline at end of file
@@ -9,16 +9,9 @@ namespace DependencyGraph {
         unsigned int tDist = getDistance();
 
         setDistance(std::max(sDist, tDist));
-        auto it = dependency_set.begin();
-        auto pit = dependency_set.before_begin();
-        while(it != dependency_set.end())
-        {
-            if(*it == e) return;
-            if(*it > e) break;
-            pit = it;
-            ++it;
-        }
-        dependency_set.insert_after(pit, e);
+        auto it = std::lower_bound(dependency_set.begin(), dependency_set.end(), e);
+        if(it != dependency_set.end() && *it == e) return;
+        dependency_set.insert(it, e);
         ++e->refcnt;
     }
 }
\ No newline at end of file
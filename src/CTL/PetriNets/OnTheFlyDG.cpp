@@ -13,19 +13,34 @@
 #include "PetriEngine/Stubborn/ReachabilityStubbornSet.h"
 #include "PetriEngine/PQL/PredicateCheckers.h"
 #include "PetriEngine/PQL/Evaluation.h"
+#include "PetriEngine/PQL/ContainsVisitor.h"
+#include "PetriEngine/PQL/PlaceUseVisitor.h"
+#include "PetriEngine/Reducer.h"
+#include "PetriEngine/Structures/MarkingKernels.h"
+#include "PetriEngine/Structures/StateSet.h"
 
 using namespace PetriEngine::PQL;
 using namespace DependencyGraph;
 
 namespace PetriNets {
 
-OnTheFlyDG::OnTheFlyDG(PetriEngine::PetriNet *t_net, bool partial_order) : encoder(t_net->numberOfPlaces(), 0),
+OnTheFlyDG::OnTheFlyDG(PetriEngine::PetriNet *t_net, bool partial_order, size_t workers) :
         edge_alloc(new linked_bucket_t<DependencyGraph::Edge,1024*10>(1)),
         conf_alloc(new linked_bucket_t<char[sizeof(PetriConfig)], 1024*1024>(1)),
-        _redgen(*t_net, std::make_shared<PetriEngine::ReachabilityStubbornSet>(*t_net)), _partial_order(partial_order) {
+        _stubborn(std::make_shared<PetriEngine::ReachabilityStubbornSet>(*t_net)),
+        _redgen(*t_net, _stubborn), _partial_order(partial_order) {
     net = t_net;
     n_places = t_net->numberOfPlaces();
     n_transitions = t_net->numberOfTransitions();
+    _workers.emplace_back(std::make_unique<worker_t>(n_places));
+    // over-provision shards to keep contention on the locks low
+    size_t nshards = 1;
+    while(workers > 1 && nshards < workers * 8)
+    {
+        nshards <<= 1;
+        ++_shardbits;
+    }
+    _shards = std::vector<shard_t>(nshards);
 }
 
 
@@ -46,7 +61,7 @@ OnTheFlyDG::~OnTheFlyDG()
 Condition::Result OnTheFlyDG::initialEval()
 {
     initialConfiguration();
-    EvaluationContext e(query_marking.marking(), net);
+    EvaluationContext e(_workers[0]->query_marking.marking(), net);
     return PetriEngine::PQL::evaluate(query, e);
 }
 
@@ -57,12 +72,25 @@ Condition::Result OnTheFlyDG::fastEval(Condition* query, Marking* unfolded)
 }
 
 
-std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
+std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c, size_t worker)
 {
+    auto succs = computeSuccessors(c, worker);
+    for(size_t i = 0; i < succs.size(); ++i)
+    {
+        succs[i]->index = i;
+        // targets are appended, the algorithms try them newest first
+        std::reverse(succs[i]->targets.begin(), succs[i]->targets.end());
+    }
+    return succs;
+}
+
+std::vector<DependencyGraph::Edge*> OnTheFlyDG::computeSuccessors(Configuration *c, size_t worker)
+{
+    auto& w = *_workers[worker];
+    auto& query_marking = w.query_marking;
     PetriEngine::PQL::DistanceContext context(net, query_marking.marking());
     PetriConfig *v = static_cast<PetriConfig*>(c);
-    trie.unpack(v->marking, encoder.scratchpad().raw());
-    encoder.decode(query_marking.marking(), encoder.scratchpad().raw());
+    decodeMarking(v->marking, w, query_marking);
     //    v->printConfiguration();
     std::vector<Edge*> succs;
     auto query_type = v->query->getQueryType();
@@ -78,7 +106,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
             // no need to try to evaluate here -- this is already transient in other evaluations.
             auto cond = static_cast<NotCondition*>(v->query);
             Configuration* c = createConfiguration(v->marking, v->getOwner(), (*cond)[0]);
-            Edge* e = newEdge(*v, /*v->query->distance(context)*/0);
+            Edge* e = newEdge(*v, weight(v->query, context));
             e->is_negated = true;
             e->addTarget(c);
             succs.push_back(e);
@@ -100,7 +128,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                 }
             }
 
-            Edge *e = newEdge(*v, /*cond->distance(context)*/0);
+            Edge *e = newEdge(*v, weight(cond, context));
 
             //If we get here, then either both propositions are true (shouldn't be possible)
             //Or a temporal operator and a true proposition
@@ -136,7 +164,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
             for(auto c : conds)
             {
                 assert(PetriEngine::PQL::isTemporal(c));
-                Edge *e = newEdge(*v, /*cond->distance(context)*/0);
+                Edge *e = newEdge(*v, weight(c, context));
                 e->addTarget(createConfiguration(v->marking, v->getOwner(), c));
                 succs.push_back(e);
             }
@@ -161,7 +189,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                 else {
                     //right side is temporal, we need to evaluate it as normal
                     Configuration* c = createConfiguration(v->marking, v->getOwner(), (*cond)[1]);
-                    right = newEdge(*v, /*(*cond)[1]->distance(context)*/0);
+                    right = newEdge(*v, weight((*cond)[1].get(), context));
                     right->addTarget(c);
                 }
                 bool valid = false;
@@ -177,7 +205,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                 if (valid || left != NULL) {
                     //if left side is guaranteed to be not satisfied, skip successor generation
                     Edge* leftEdge = NULL;
-                    nextStates (query_marking, cond,
+                    nextStates(w, v->marking, cond,
                                 [&](){ leftEdge = newEdge(*v, std::numeric_limits<uint32_t>::max());},
                                 [&](Marking& mark){
                                     auto res = fastEval(cond, &mark);
@@ -185,12 +213,12 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                                     if(res == Condition::RFALSE)
                                     {
                                         left = nullptr;
-                                        leftEdge->targets.clear();
+                                        clearTargets(leftEdge);
                                         leftEdge = nullptr;
                                         return false;
                                     }
                                     context.setMarking(mark.marking());
-                                    Configuration* c = createConfiguration(createMarking(mark), owner(mark, cond), cond);
+                                    Configuration* c = createConfiguration(createMarking(mark, w), owner(mark, cond), cond);
                                     leftEdge->addTarget(c);
                                     return true;
                                 },
@@ -222,12 +250,12 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                         return succs;
                     }
                 } else {
-                    subquery = newEdge(*v, /*cond->distance(context)*/0);
+                    subquery = newEdge(*v, weight(cond, context));
                     Configuration* c = createConfiguration(v->marking, v->getOwner(), (*cond)[0]);
                     subquery->addTarget(c);
                 }
                 Edge* e1 = NULL;
-                nextStates(query_marking, cond,
+                nextStates(w, v->marking, cond,
                         [&](){e1 = newEdge(*v, std::numeric_limits<uint32_t>::max());},
                         [&](Marking& mark)
                         {
@@ -241,11 +269,11 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                                     release(subquery);
                                     subquery = nullptr;
                                 }
-                                e1->targets.clear();
+                                clearTargets(e1);
                                 return false;
                             }
                             context.setMarking(mark.marking());
-                            Configuration* c = createConfiguration(createMarking(mark), owner(mark, cond), cond);
+                            Configuration* c = createConfiguration(createMarking(mark, w), owner(mark, cond), cond);
                             e1->addTarget(c);
                             return true;
                         },
@@ -263,7 +291,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                 auto cond = static_cast<AXCondition*>(v->query);
                 Edge* e = newEdge(*v, std::numeric_limits<uint32_t>::max());
                 Condition::Result allValid = Condition::RTRUE;
-                nextStates(query_marking, cond,
+                nextStates(w, v->marking, cond,
                         [](){},
                         [&](Marking& mark){
                             auto res = fastEval((*cond)[0], &mark);
@@ -278,7 +306,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                             {
                                 allValid = Condition::RUNKNOWN;
                                 context.setMarking(mark.marking());
-                                Configuration* c = createConfiguration(createMarking(mark), v->getOwner(), (*cond)[0]);
+                                Configuration* c = createConfiguration(createMarking(mark, w), v->getOwner(), (*cond)[0]);
                                 e->addTarget(c);
                             }
                             return true;
@@ -291,11 +319,13 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                     }
                     else if(allValid == Condition::RTRUE)
                     {
-                        e->targets.clear();
+                        clearTargets(e);
                         succs.push_back(e);
                     }
                     else
                     {
+                        --e->refcnt;
+                        release(e);
                     }
             }
             else if(v->query->getPath() == G ){
@@ -311,7 +341,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                 auto r1 = fastEval((*cond)[1], &query_marking);
                 if (r1 == Condition::RUNKNOWN) {
                     Configuration* c = createConfiguration(v->marking, v->getOwner(), (*cond)[1]);
-                    right = newEdge(*v, /*(*cond)[1]->distance(context)*/0);
+                    right = newEdge(*v, weight((*cond)[1].get(), context));
                     right->addTarget(c);
                 } else {
                     bool valid = r1 == Condition::RTRUE;
@@ -324,7 +354,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
 
                 Configuration *left = NULL;
                 bool valid = false;
-                nextStates(query_marking, cond,
+                nextStates(w, v->marking, cond,
                     [&](){
                         auto r0 = fastEval((*cond)[0], &query_marking);
                         if (r0 == Condition::RUNKNOWN) {
@@ -357,8 +387,8 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                             return false;
                         }
                         context.setMarking(marking.marking());
-                        Edge* e = newEdge(*v, /*cond->distance(context)*/0);
-                        Configuration* c1 = createConfiguration(createMarking(marking), owner(marking, cond), cond);
+                        Edge* e = newEdge(*v, weight(cond, context));
+                        Configuration* c1 = createConfiguration(createMarking(marking, w), owner(marking, cond), cond);
                         e->addTarget(c1);
                         if (left != NULL) {
                             e->addTarget(left);
@@ -383,11 +413,11 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                     }
                 } else {
                     Configuration* c = createConfiguration(v->marking, v->getOwner(), (*cond)[0]);
-                    subquery = newEdge(*v, /*cond->distance(context)*/0);
+                    subquery = newEdge(*v, weight(cond, context));
                     subquery->addTarget(c);
                 }
 
-                nextStates(query_marking, cond,
+                nextStates(w, v->marking, cond,
                             [](){},
                             [&](Marking& mark){
                                 auto res = fastEval(cond, &mark);
@@ -406,8 +436,8 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                                     return false;
                                 }
                                 context.setMarking(mark.marking());
-                                Edge* e = newEdge(*v, /*cond->distance(context)*/0);
-                                Configuration* c = createConfiguration(createMarking(mark), owner(mark, cond), cond);
+                                Edge* e = newEdge(*v, weight(cond, context));
+                                Configuration* c = createConfiguration(createMarking(mark, w), owner(mark, cond), cond);
                                 e->addTarget(c);
                                 succs.push_back(e);
                                 return true;
@@ -422,7 +452,7 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
             else if(v->query->getPath() == X){
                 auto cond = static_cast<EXCondition*>(v->query);
                 auto query = (*cond)[0];
-                nextStates(query_marking, cond,
+                nextStates(w, v->marking, cond,
                         [](){},
                         [&](Marking& marking) {
                             auto res = fastEval(query, &marking);
@@ -436,8 +466,8 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
                             else if(res == Condition::RUNKNOWN)
                             {
                                 context.setMarking(marking.marking());
-                                Edge* e = newEdge(*v, /*(*cond)[0]->distance(context)*/0);
-                                Configuration* c = createConfiguration(createMarking(marking), v->getOwner(), query);
+                                Edge* e = newEdge(*v, weight(query.get(), context));
+                                Configuration* c = createConfiguration(createMarking(marking, w), v->getOwner(), query);
                                 e->addTarget(c);
                                 succs.push_back(e);
                             }
@@ -457,48 +487,137 @@ std::vector<DependencyGraph::Edge*> OnTheFlyDG::successors(Configuration *c)
     {
         assert(false && "Should never happen");
     }
-    /*
-    // legacy code from distributed version
-    if(succs.size() == 1 && succs[0]->targets.size() == 1)
-    {
-        ((PetriConfig*)succs[0]->targets[0])->setOwner(v->getOwner());
-    }*/
     return succs;
 }
 
 Configuration* OnTheFlyDG::initialConfiguration()
 {
-    if(working_marking.marking() == nullptr)
+    auto& w = *_workers[0];
+    if(w.working_marking.marking() == nullptr)
     {
-        working_marking.setMarking  (net->makeInitialMarking());
-        query_marking.setMarking    (net->makeInitialMarking());
-        auto o = owner(working_marking, this->query);
-        initial_config = createConfiguration(createMarking(working_marking), o, this->query);
+        w.working_marking.setMarking  (net->makeInitialMarking());
+        w.query_marking.setMarking    (net->makeInitialMarking());
+        auto o = owner(w.working_marking, this->query);
+        initial_config = createConfiguration(createMarking(w.working_marking, w), o, this->query);
     }
     return initial_config;
 }
 
 
-void OnTheFlyDG::nextStates(Marking& t_marking, Condition* ptr,
-    std::function<void ()> pre,
-    std::function<bool (Marking&)> foreach,
-    std::function<void ()> post)
+bool OnTheFlyDG::reducible(Condition* ptr) const
+{
+    if(!_partial_order || ptr->getQuantifier() != E) return false;
+    if(ptr->getPath() == F)
+        return !PetriEngine::PQL::isTemporal((*static_cast<QuantifierCondition*>(ptr))[0]);
+    if(ptr->getPath() != U) return false;
+    // the left side must keep its value along the reordered paths, a
+    // deadlock proposition is changed by any transition
+    auto cond = static_cast<EUCondition*>(ptr);
+    if(PetriEngine::PQL::isTemporal((*cond)[0]) || PetriEngine::PQL::isTemporal((*cond)[1]))
+        return false;
+    PetriEngine::ContainsVisitor<DeadlockCondition> deadlock;
+    Visitor::visit(deadlock, (*cond)[0]);
+    return !deadlock.does_contain();
+}
+
+bool OnTheFlyDG::prepareReduced(worker_t& w, Condition* ptr)
 {
-    bool first = true;
-    memcpy(working_marking.marking(), query_marking.marking(), n_places*sizeof(PetriEngine::MarkVal));
-    auto qf = static_cast<QuantifierCondition*>(ptr);
-    if(!_partial_order || ptr->getQuantifier() != E || ptr->getPath() != F || PetriEngine::PQL::isTemporal((*qf)[0]))
+    _redgen.setQuery(ptr);
+    if(!_redgen.prepare(&w.query_marking))
+        return true;
+    const std::vector<bool>* visible = nullptr;
+    if(ptr->getPath() == U)
+        visible = &visibleTransitions((*static_cast<EUCondition*>(ptr))[0].get());
+    // Rule V': reordering a visible transition could leave the left side,
+    // so the set is only used if all its enabled transitions are invisible
+    const bool* enabled = _stubborn->enabled();
+    const bool* stubborn = _stubborn->stubborn();
+    size_t nstubborn = 0;
+    for(uint32_t t = 0; t < n_transitions; ++t)
     {
-        PetriEngine::SuccessorGenerator PNGen(*net);
-        dowork<PetriEngine::SuccessorGenerator>(PNGen, first, pre, foreach);
+        if(!enabled[t] || !stubborn[t]) continue;
+        if(visible && (*visible)[t])
+        {
+            _redgen.reset();
+            return false;
+        }
+        ++nstubborn;
     }
-    else
+    if(nstubborn < _stubborn->nenabled())
+        ++_reducedExpansions;
+    return true;
+}
+
+const std::vector<bool>& OnTheFlyDG::visibleTransitions(Condition* cond)
+{
+    auto it = _visible.find(cond);
+    if(it != _visible.end())
+        return it->second;
+    PlaceUseVisitor places(n_places);
+    Visitor::visit(places, cond);
+    std::vector<bool> visible(n_transitions, false);
+    for(uint32_t t = 0; t < n_transitions; ++t)
     {
-        _redgen.setQuery(ptr);
-        dowork<PetriEngine::ReducingSuccessorGenerator>(_redgen, first, pre, foreach);
+        auto [finv, linv] = net->preset(t);
+        for(; finv != linv; ++finv)
+            if(!finv->inhibitor && finv->direction != 0 && places[finv->place])
+                visible[t] = true;
+        auto [fout, lout] = net->postset(t);
+        for(; fout != lout; ++fout)
+            if(fout->direction != 0 && places[fout->place])
+                visible[t] = true;
     }
+    return _visible.emplace(cond, std::move(visible)).first->second;
+}
 
-    if(!first) post();
+void OnTheFlyDG::setSuccessorCache(size_t markings)
+{
+    auto lk = guard(_cacheLock);
+    _successorCacheSize = markings;
+    while(_successorCache.size() > markings)
+    {
+        _successorIndex.erase(_successorCache.back().first);
+        _successorCache.pop_back();
+    }
+}
+
+bool OnTheFlyDG::lookupSuccessors(size_t marking, std::vector<size_t>& successors)
+{
+    auto lk = guard(_cacheLock);
+    auto it = _successorIndex.find(marking);
+    if(it == _successorIndex.end())
+    {
+        ++_cacheMisses;
+        return false;
+    }
+    ++_cacheHits;
+    _successorCache.splice(_successorCache.begin(), _successorCache, it->second);
+    successors = it->second->second;
+    return true;
+}
+
+void OnTheFlyDG::storeSuccessors(size_t marking, const std::vector<size_t>& successors)
+{
+    auto lk = guard(_cacheLock);
+    // another worker may have expanded the same marking meanwhile
+    if(_successorIndex.count(marking) > 0) return;
+    if(_successorCache.size() >= _successorCacheSize)
+    {
+        _successorIndex.erase(_successorCache.back().first);
+        _successorCache.pop_back();
+    }
+    _successorCache.emplace_front(marking, successors);
+    _successorIndex[marking] = _successorCache.begin();
+}
+
+void OnTheFlyDG::decodeMarking(size_t id, worker_t& w, Marking& marking)
+{
+    {
+        auto& shard = shardOf(id);
+        auto lk = guard(shard.lock);
+        shard.trie.unpack(indexOf(id), w.encoder.scratchpad().raw());
+    }
+    w.encoder.decode(marking.marking(), w.encoder.scratchpad().raw());
 }
 
 void OnTheFlyDG::cleanUp()
@@ -514,15 +633,66 @@ void OnTheFlyDG::cleanUp()
 
 void OnTheFlyDG::setQuery(Condition* query)
 {
+    resetSearch();
+    // the subformulas of earlier queries may be gone
+    _visible.clear();
     this->query = query;
-    delete[] working_marking.marking();
-    delete[] query_marking.marking();
-    working_marking.setMarking(nullptr);
-    query_marking.setMarking(nullptr);
+    auto& w = *_workers[0];
+    delete[] w.working_marking.marking();
+    delete[] w.query_marking.marking();
+    w.working_marking.setMarking(nullptr);
+    w.query_marking.setMarking(nullptr);
     initialConfiguration();
     assert(this->query);
 }
 
+void OnTheFlyDG::resetSearch()
+{
+    // edges still alive were held by the waiting lists of the last algorithm
+    size_t n = edge_alloc->size();
+    for(size_t i = 0; i < n; ++i)
+    {
+        Edge* e = &(*edge_alloc)[i];
+        if(e->refcnt == -1) continue;
+        e->targets.clear();
+        e->source = nullptr;
+        e->status = 0;
+        e->is_negated = false;
+        e->processed = false;
+        e->handled = false;
+        e->refcnt = -1;
+        recycle.push(e);
+    }
+    // no edge is left, so the undecided configurations are reclaimed by the
+    // next collect unless the next search takes them again
+    _unreferenced.clear();
+    n = conf_alloc->size();
+    for(size_t i = 0; i < n; ++i)
+    {
+        auto c = (PetriConfig*)&(*conf_alloc)[i];
+        if(c->query == nullptr) continue;
+        c->resetSearch();
+        if(!c->isDone())
+            _unreferenced.push_back(c);
+    }
+}
+
+size_t OnTheFlyDG::prepareWorkers(size_t n)
+{
+    // the stubborn sets annotate the (shared) query while computing, so workers use full expansion
+    if(n > 1)
+        _partial_order = false;
+    while(_workers.size() < n)
+    {
+        auto w = std::make_unique<worker_t>(n_places);
+        w->working_marking.setMarking(net->makeInitialMarking());
+        w->query_marking.setMarking(net->makeInitialMarking());
+        _workers.emplace_back(std::move(w));
+    }
+    _concurrent = n > 1;
+    return n;
+}
+
 size_t OnTheFlyDG::configurationCount() const
 {
     return _configurationCount;
@@ -533,18 +703,79 @@ size_t OnTheFlyDG::markingCount() const
     return _markingCount;
 }
 
+size_t OnTheFlyDG::reclaimedCount() const
+{
+    return _reclaimedCount;
+}
+
+size_t OnTheFlyDG::allocatedConfigurationCount()
+{
+    auto lk = guard(_configLock);
+    return conf_alloc->size();
+}
+
+size_t OnTheFlyDG::edgeCount()
+{
+    auto lk = guard(_edgeLock);
+    return edge_alloc->size();
+}
+
+size_t OnTheFlyDG::memoryUsage()
+{
+    size_t markings = _markingBytes
+        + _markingCount * (sizeof(std::vector<PetriConfig*>) + sizeof(size_t))
+        + allocatedConfigurationCount() * sizeof(PetriConfig*);
+    return configurationBytes() + edgeBytes() + markings;
+}
+
+size_t OnTheFlyDG::configurationBytes()
+{
+    auto lk = guard(_configLock);
+    size_t s = conf_alloc->size();
+    size_t bytes = s * sizeof(PetriConfig);
+    for(size_t i = 0; i < s; ++i)
+        bytes += ((PetriConfig*)&(*conf_alloc)[i])->dependency_set.heapBytes();
+    return bytes;
+}
+
+size_t OnTheFlyDG::edgeBytes()
+{
+    auto lk = guard(_edgeLock);
+    size_t s = edge_alloc->size();
+    size_t bytes = s * sizeof(Edge);
+    for(size_t i = 0; i < s; ++i)
+        bytes += (*edge_alloc)[i].targets.heapBytes();
+    return bytes;
+}
+
 PetriConfig *OnTheFlyDG::createConfiguration(size_t marking, size_t own, Condition* t_query)
 {
-    auto& configs = trie.get_data(marking);
+    auto& shard = shardOf(marking);
+    auto lk = guard(shard.lock);
+    auto& configs = shard.trie.get_data(indexOf(marking));
     for(PetriConfig* c : configs){
         if(c->query == t_query)
             return c;
     }
 
-    _configurationCount++;
-    size_t id = conf_alloc->next(0);
-    char* mem = (*conf_alloc)[id];
-    PetriConfig* newConfig = new (mem) PetriConfig();
+    PetriConfig* newConfig;
+    {
+        auto clk = guard(_configLock);
+        _configurationCount++;
+        if(_freeConfigs.empty())
+        {
+            size_t id = conf_alloc->next(0);
+            char* mem = (*conf_alloc)[id];
+            newConfig = new (mem) PetriConfig();
+        }
+        else
+        {
+            newConfig = _freeConfigs.top();
+            _freeConfigs.pop();
+        }
+        // reclaimed by the next collect unless an edge takes it
+        _unreferenced.push_back(newConfig);
+    }
     newConfig->marking = marking;
     newConfig->query = t_query;
     newConfig->setOwner(own);
@@ -554,7 +785,10 @@ PetriConfig *OnTheFlyDG::createConfiguration(size_t marking, size_t own, Conditi
 
 
 
-size_t OnTheFlyDG::createMarking(Marking& t_marking){
+size_t OnTheFlyDG::createMarking(Marking& t_marking, worker_t& w){
+    if(&t_marking == &w.working_marking && w.working_id != NO_MARKING)
+        return w.working_id;
+    auto& encoder = w.encoder;
     size_t sum = 0;
     bool allsame = true;
     uint32_t val = 0;
@@ -563,51 +797,307 @@ size_t OnTheFlyDG::createMarking(Marking& t_marking){
     markingStats(t_marking.marking(), sum, allsame, val, active, last);
     unsigned char type = encoder.getType(sum, active, allsame, val);
     size_t length = encoder.encode(t_marking.marking(), type);
-    binarywrapper_t w = binarywrapper_t(encoder.scratchpad().raw(), length*8);
-    auto tit = trie.insert(w.raw(), w.size());
+    binarywrapper_t bw = binarywrapper_t(encoder.scratchpad().raw(), length*8);
+    size_t sid = 0;
+    if(_shards.size() > 1)
+        sid = PetriEngine::Structures::StateSetInterface::encodingHash(bw.raw(), length) & (_shards.size() - 1);
+    auto& shard = _shards[sid];
+    auto lk = guard(shard.lock);
+    auto tit = shard.trie.insert(bw.raw(), bw.size());
     if(tit.first){
         _markingCount++;
+        _markingBytes += length;
     }
 
-    return tit.second;
+    return (tit.second << _shardbits) | sid;
 }
 
 void OnTheFlyDG::release(Edge* e)
 {
     assert(e->refcnt == 0);
+    for(auto t : e->targets)
+        unreference(t);
+    unreference(e->source);
     e->is_negated = false;
     e->processed = false;
     e->source = nullptr;
     e->targets.clear();
     e->refcnt = -1;
     e->handled = false;
+    auto lk = guard(_edgeLock);
     recycle.push(e);
 }
 
+void OnTheFlyDG::release(Configuration* c)
+{
+    unreference(c);
+}
+
+void OnTheFlyDG::unreference(Configuration* c)
+{
+    assert(c->refcnt > 0);
+    if(c->refcnt.fetch_sub(1, std::memory_order_relaxed) == 1)
+    {
+        auto lk = guard(_configLock);
+        _unreferenced.push_back(static_cast<PetriConfig*>(c));
+    }
+}
+
+void OnTheFlyDG::clearTargets(Edge* e)
+{
+    for(auto t : e->targets)
+        unreference(t);
+    e->targets.clear();
+}
+
+void OnTheFlyDG::collect()
+{
+    std::vector<PetriConfig*> unreferenced;
+    {
+        auto lk = guard(_configLock);
+        unreferenced.swap(_unreferenced);
+    }
+    for(PetriConfig* c : unreferenced)
+    {
+        // listed more than once, or referenced again since
+        if(c->query == nullptr || c->refcnt > 0) continue;
+        if(c == initial_config) continue;
+        // final assignments are kept, a later predecessor or query would otherwise
+        // explore the subtree below c again; their dependency sets are already
+        // released by the algorithms when the assignment is made
+        if(c->isDone() || c->assignment == ZERO) continue;
+        // the witnesses of later assignments may lead through c
+        if(_witnesses && c->witness != 0) continue;
+        {
+            auto& shard = shardOf(c->marking);
+            auto lk = guard(shard.lock);
+            auto& configs = shard.trie.get_data(indexOf(c->marking));
+            auto it = std::find(configs.begin(), configs.end(), c);
+            assert(it != configs.end());
+            *it = configs.back();
+            configs.pop_back();
+            if(configs.empty())
+                std::vector<PetriConfig*>().swap(configs);
+        }
+        assert(c->dependency_set.empty());
+        c->~PetriConfig();
+        new (c) PetriConfig();
+        auto lk = guard(_configLock);
+        _freeConfigs.push(c);
+        ++_reclaimedCount;
+    }
+}
+
+void OnTheFlyDG::recordWitnesses(const PetriEngine::Reducer* reducer)
+{
+    _witnesses = true;
+    _reducer = reducer;
+}
+
+bool OnTheFlyDG::printWitness(std::ostream& out)
+{
+    auto root = static_cast<PetriConfig*>(initialConfiguration());
+    // an answer given by the initial marking has the empty trace
+    if(root->witness == 0 && initialEval() == Condition::RUNKNOWN)
+        return false;
+    out << "<trace>\n";
+    if(_reducer != nullptr)
+        _reducer->initFire(out);
+    printWitness(root, out, 1);
+    out << "</trace>\n";
+    return true;
+}
+
+void OnTheFlyDG::printWitness(PetriConfig* c, std::ostream& out, size_t depth)
+{
+    // paths are printed iteratively, only branches recurse
+    while(c != nullptr)
+    {
+        auto steps = witnessSteps(c);
+        if(steps.size() == 1)
+        {
+            if(steps[0].transition != NO_TRANSITION)
+                printTransition(steps[0].transition, out, depth);
+            c = steps[0].config;
+            continue;
+        }
+        std::string indent(depth, '\t');
+        for(auto& s : steps)
+        {
+            out << indent << "<branch>\n";
+            if(s.transition != NO_TRANSITION)
+                printTransition(s.transition, out, depth + 1);
+            printWitness(s.config, out, depth + 1);
+            out << indent << "</branch>\n";
+        }
+        return;
+    }
+}
+
+void OnTheFlyDG::printTransition(uint32_t t, std::ostream& out, size_t depth) const
+{
+    std::string indent(depth, '\t');
+    const auto& name = *net->transitionNames()[t];
+    out << indent << "<transition id=\"" << name << "\" index=\"" << t << "\">\n";
+    auto [finv, linv] = net->preset(t);
+    for(; finv != linv; ++finv)
+    {
+        if(finv->inhibitor) continue;
+        for(uint32_t i = 0; i < finv->tokens; ++i)
+            out << indent << "\t<token place=\"" << *net->placeNames()[finv->place] << "\" age=\"0\"/>\n";
+    }
+    if(_reducer != nullptr)
+        _reducer->extraConsume(out, name);
+    out << indent << "</transition>\n";
+    if(_reducer != nullptr)
+        _reducer->postFire(out, name);
+}
+
+std::vector<OnTheFlyDG::witness_step_t> OnTheFlyDG::witnessSteps(PetriConfig* c)
+{
+    std::vector<witness_step_t> steps;
+    if(c->witness == 0) return steps;
+
+    // successors are computed in the same order again, the edge is not kept
+    std::vector<PetriConfig*> targets;
+    bool negated = false;
+    {
+        auto succs = successors(c);
+        assert(c->witness <= succs.size());
+        if(c->witness <= succs.size())
+        {
+            auto e = succs[c->witness - 1];
+            negated = e->is_negated;
+            for(auto t : e->targets)
+                targets.push_back(static_cast<PetriConfig*>(t));
+        }
+        for(auto e : succs)
+        {
+            --e->refcnt;
+            if(e->refcnt == 0) release(e);
+        }
+    }
+
+    auto query = c->query;
+    if(negated)
+    {
+        // the subformula holds, its witness is the counterexample of c;
+        // the subformula failing has no finite witness
+        if(c->assignment == CZERO && !targets.empty())
+            steps.push_back({NO_TRANSITION, targets.front()});
+        return steps;
+    }
+    if(query->getQueryType() != PATHQEURY)
+    {
+        for(auto t : targets)
+            steps.push_back({NO_TRANSITION, t});
+        return steps;
+    }
+
+    auto path = query->getPath();
+    bool all = query->getQuantifier() == A;
+    Condition* goal = path == U ? (*static_cast<UntilCondition*>(query))[1].get()
+                                : (*static_cast<QuantifierCondition*>(query))[0].get();
+    auto& w = *_workers[0];
+    decodeMarking(c->marking, w, w.query_marking);
+
+    // targets in the same marking are subformulas, successors have the query itself
+    std::vector<PetriConfig*> next;
+    for(auto t : targets)
+    {
+        if(path == X || t->query == query)
+            next.push_back(t);
+        else
+            steps.push_back({NO_TRANSITION, t});
+    }
+    if(path != X)
+    {
+        bool reached = PetriEngine::PQL::evaluate(goal, EvaluationContext(w.query_marking.marking(), net)) == Condition::RTRUE;
+        for(auto t : targets)
+            reached |= t->query == goal;
+        if(reached) return steps;
+    }
+
+    std::vector<uint32_t> fired;
+    std::vector<PetriEngine::MarkVal> markings;
+    {
+        PetriEngine::SuccessorGenerator gen(*net);
+        gen.prepare(&w.query_marking);
+        while(gen.next(w.working_marking))
+        {
+            fired.push_back(gen.fired());
+            markings.insert(markings.end(), w.working_marking.marking(), w.working_marking.marking() + n_places);
+        }
+    }
+    std::vector<PetriConfig*> at(fired.size(), nullptr);
+    for(auto t : next)
+    {
+        decodeMarking(t->marking, w, w.working_marking);
+        for(size_t i = 0; i < fired.size(); ++i)
+        {
+            if(memcmp(&markings[i * n_places], w.working_marking.marking(), n_places * sizeof(PetriEngine::MarkVal)) == 0)
+                at[i] = t;
+        }
+    }
+
+    if(all)
+    {
+        // successors without configuration satisfy the query directly
+        for(size_t i = 0; i < fired.size(); ++i)
+            steps.push_back({fired[i], at[i]});
+        return steps;
+    }
+    size_t i = 0;
+    if(!next.empty())
+    {
+        while(i < fired.size() && at[i] != next.front()) ++i;
+    }
+    else
+    {
+        while(i < fired.size() &&
+              PetriEngine::PQL::evaluate(goal, EvaluationContext(&markings[i * n_places], net)) != Condition::RTRUE)
+            ++i;
+    }
+    assert(i < fired.size());
+    if(i < fired.size())
+        steps.push_back({fired[i], at[i]});
+    return steps;
+}
+
 size_t OnTheFlyDG::owner(Marking& marking, Condition* cond) {
     // Used for distributed algorithm
     return 0;
 }
 
 
+uint32_t OnTheFlyDG::weight(Condition* cond, PetriEngine::PQL::DistanceContext& context) const
+{
+    return _distanceHeuristic ? cond->distance(context) : 0;
+}
+
 Edge* OnTheFlyDG::newEdge(Configuration &t_source, uint32_t weight)
 {
     Edge* e = nullptr;
-    if(recycle.empty())
-    {
-        size_t n = edge_alloc->next(0);
-        e = &(*edge_alloc)[n];
-    }
-    else
     {
-        e = recycle.top();
-        e->refcnt = 0;
-        recycle.pop();
+        auto lk = guard(_edgeLock);
+        if(recycle.empty())
+        {
+            size_t n = edge_alloc->next(0);
+            e = &(*edge_alloc)[n];
+        }
+        else
+        {
+            e = recycle.top();
+            e->refcnt = 0;
+            recycle.pop();
+        }
     }
     assert(e->targets.empty());
     /*e->assignment = UNKNOWN;
     e->children = 0;*/
     e->source = &t_source;
+    e->weight = weight;
+    t_source.refcnt.fetch_add(1, std::memory_order_relaxed);
     assert(e->refcnt == 0);
     ++e->refcnt;
     return e;
@@ -616,21 +1106,12 @@ Edge* OnTheFlyDG::newEdge(Configuration &t_source, uint32_t weight)
 void OnTheFlyDG::markingStats(const uint32_t* marking, size_t& sum,
         bool& allsame, uint32_t& val, uint32_t& active, uint32_t& last)
 {
-    uint32_t cnt = 0;
-
-    for (uint32_t i = 0; i < n_places; i++)
-    {
-        uint32_t old = val;
-        if(marking[i] != 0)
-        {
-            ++cnt;
-            last = std::max(last, i);
-            val = std::max(marking[i], val);
-            if(old != 0 && marking[i] != old) allsame = false;
-            ++active;
-            sum += marking[i];
-        }
-    }
+    auto stats = PetriEngine::Structures::markingStats(marking, n_places);
+    sum = stats.sum;
+    allsame = stats.allsame;
+    val = stats.max;
+    active = stats.active;
+    last = stats.last;
 }
 
 
@@ -9,22 +9,31 @@
 #include "CTL/DependencyGraph/Edge.h"
 #include "CTL/DependencyGraph/Configuration.h"
 
+#include <algorithm>
+#include <cassert>
+
 namespace SearchStrategy {
 
     size_t HeuristicSearch::Wsize() const {
-        return W.size();
+        return _size;
     }
 
     void HeuristicSearch::pushToW(DependencyGraph::Edge* edge) {
-        W.push_back(edge);
+        size_t bucket = std::min(edge->weight, MAXBUCKET);
+        if(bucket >= W.size())
+            W.resize(bucket + 1);
+        W[bucket].push_back(edge);
+        _min = std::min(_min, bucket);
+        ++_size;
     }
 
     DependencyGraph::Edge* HeuristicSearch::popFromW() {
-        auto it = std::max_element(W.begin(), W.end(), [](auto a, auto b){
-            return false; // a->targets.size() < b->targets.size();
-        });
-        auto edge = *it;
-        W.erase(it);
+        assert(_size > 0);
+        while(W[_min].empty())
+            ++_min;
+        auto edge = W[_min].back();
+        W[_min].pop_back();
+        --_size;
         return edge;
     }  
 }
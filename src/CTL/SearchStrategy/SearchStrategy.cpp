@@ -90,6 +90,11 @@ namespace SearchStrategy{
         return m;
     }
 
+    size_t SearchStrategy::size() const
+    {
+        return Wsize() + N.size() + D.size();
+    }
+
     bool SearchStrategy::available() const
     {
         return Wsize() > 0 || !D.empty();
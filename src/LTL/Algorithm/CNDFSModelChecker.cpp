@@ -0,0 +1,258 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LTL/Algorithm/CNDFSModelChecker.h"
+#include "LTL/Structures/GuardInfo.h"
+#include "PetriEngine/PQL/Evaluation.h"
+
+#include <exception>
+#include <random>
+#include <thread>
+
+namespace LTL {
+
+    struct CNDFSModelChecker::worker_t {
+        worker_t(const PetriEngine::PetriNet& net, Structures::ProductStateFactory& factory, uint64_t seed, bool shuffle)
+        : _generator(net), _parent(factory.new_state()), _working(factory.new_state()),
+          _rng(seed), _shuffle(shuffle) {}
+
+        PetriEngine::SuccessorGenerator _generator;
+        State _parent;
+        State _working;
+        // states on the blue stack of this thread
+        std::unordered_set<Structures::stateid_t> _cyan;
+        // states seen by the current red search, with their data_id
+        std::unordered_map<Structures::stateid_t, size_t> _red;
+        std::mt19937_64 _rng;
+        bool _shuffle;
+        size_t _explored = 0;
+        size_t _expanded = 0;
+    };
+
+    CNDFSModelChecker::CNDFSModelChecker(const PetriEngine::PetriNet& net, const PetriEngine::PQL::Condition_ptr &query,
+                                         const Structures::BuchiAutomaton &buchi, uint32_t kbound, uint32_t threads,
+                                         uint64_t seed)
+    : ModelChecker(net, query, buchi), _states(net, kbound, std::max<uint32_t>(threads, 1) * 16),
+      _threads(std::max<uint32_t>(threads, 1)), _seed(seed)
+    {
+        if (buchi.buchi().num_states() > 1048576) {
+            throw base_error("Cannot handle Büchi automata larger than 2^20 states");
+        }
+        for (auto& info : guard_info_t::from_automaton(buchi)) {
+            _accepting.push_back(info._is_accepting);
+            _invariant_self_loop.push_back(info._retarding._bdd == bddtrue);
+            _edges.emplace_back();
+            if (info._retarding._bdd != bddfalse) {
+                _guards.push_back(info._retarding._condition);
+                _edges.back().push_back(edge_t{info._retarding._dest, _guards.back().get()});
+            }
+            for (auto& g : info._progressing) {
+                _guards.push_back(g._condition);
+                _edges.back().push_back(edge_t{g._dest, _guards.back().get()});
+            }
+        }
+
+        // the initial states are the Büchi successors of the initial marking
+        State state = _factory.new_state();
+        auto init = state.get_buchi_state();
+        for (auto& e : _edges[init]) {
+            PetriEngine::PQL::EvaluationContext ctx{state.marking(), &_net};
+            if (PetriEngine::PQL::evaluate(e._guard, ctx) != PetriEngine::PQL::Condition::RTRUE)
+                continue;
+            state.set_buchi_state(e._dest);
+            auto [is_new, id, data] = _states.add(state);
+            if (id == std::numeric_limits<size_t>::max() || !is_new)
+                continue;
+            _initial.push_back(successor_t{id, data, NO_TRANSITION});
+        }
+    }
+
+    bool CNDFSModelChecker::check()
+    {
+        std::vector<std::thread> threads;
+        std::vector<std::exception_ptr> errors(_threads);
+        for (size_t i = 0; i < _threads; ++i) {
+            threads.emplace_back([this, &errors, i] {
+                try {
+                    run(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                    _stop = true;
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        for (auto& e : errors)
+            if (e) std::rethrow_exception(e);
+        _explored = _shared_explored;
+        _expanded = _shared_expanded;
+        return !_violation;
+    }
+
+    void CNDFSModelChecker::run(size_t index)
+    {
+        // the first thread keeps the order of the successor generator
+        worker_t w(_net, _factory, _seed + index, index > 0);
+        auto roots = _initial;
+        if (w._shuffle)
+            std::shuffle(roots.begin(), roots.end(), w._rng);
+        for (auto& root : roots) {
+            if (_stop) break;
+            if ((_states.get_flags(root._id, root._data) & BLUE) == 0)
+                dfs_blue(w, root);
+        }
+        _shared_explored += w._explored;
+        _shared_expanded += w._expanded;
+    }
+
+    void CNDFSModelChecker::expand(worker_t& w, frame_t& frame)
+    {
+        _states.decode(w._parent, frame._id);
+        const auto& edges = _edges[w._parent.get_buchi_state()];
+        auto add_successors = [&](size_t transition) {
+            PetriEngine::PQL::EvaluationContext ctx{w._working.marking(), &_net};
+            for (auto& e : edges) {
+                if (PetriEngine::PQL::evaluate(e._guard, ctx) != PetriEngine::PQL::Condition::RTRUE)
+                    continue;
+                w._working.set_buchi_state(e._dest);
+                auto [is_new, id, data] = _states.add(w._working);
+                if (id == std::numeric_limits<size_t>::max())
+                    continue;
+                frame._successors.push_back(successor_t{id, data, transition});
+            }
+        };
+        w._generator.prepare(&w._parent);
+        bool deadlock = true;
+        while (w._generator.next(w._working)) {
+            deadlock = false;
+            add_successors(w._generator.fired());
+        }
+        if (deadlock) {
+            // a deadlocked marking loops, as in ProductSuccessorGenerator
+            std::copy(w._parent.marking(), w._parent.marking() + _net.numberOfPlaces(), w._working.marking());
+            add_successors(NO_TRANSITION);
+        }
+        if (w._shuffle)
+            std::shuffle(frame._successors.begin(), frame._successors.end(), w._rng);
+        ++w._expanded;
+    }
+
+    void CNDFSModelChecker::dfs_blue(worker_t& w, const successor_t& root)
+    {
+        std::vector<frame_t> blue;
+        auto push = [&](const successor_t& s) {
+            blue.push_back(frame_t{s._id, s._data, {}, 0});
+            if (is_accepting(s._id) && _invariant_self_loop[Structures::ConcurrentProductStateSet<>::get_buchi_state(s._id)]) {
+                // any continuation of the path is accepted
+                report(blue, nullptr, std::numeric_limits<size_t>::max());
+                return false;
+            }
+            w._cyan.insert(s._id);
+            expand(w, blue.back());
+            ++w._explored;
+            return true;
+        };
+        if (!push(root))
+            return;
+        while (!blue.empty() && !_stop) {
+            auto& top = blue.back();
+            if (top._next < top._successors.size()) {
+                auto succ = top._successors[top._next++];
+                if (w._cyan.count(succ._id) > 0 || (_states.get_flags(succ._id, succ._data) & BLUE) != 0)
+                    continue;
+                if (!push(succ))
+                    return;
+            } else {
+                if (is_accepting(top._id)) {
+                    dfs_red(w, blue);
+                    if (_stop) return;
+                }
+                _states.set_flags(top._id, top._data, BLUE);
+                w._cyan.erase(top._id);
+                blue.pop_back();
+            }
+        }
+    }
+
+    void CNDFSModelChecker::dfs_red(worker_t& w, std::vector<frame_t>& blue)
+    {
+        const auto& seed = blue.back();
+        w._red.clear();
+        w._red.emplace(seed._id, seed._data);
+        std::vector<frame_t> red;
+        red.push_back(frame_t{seed._id, seed._data, seed._successors, 0});
+        while (!red.empty()) {
+            if (_stop) return;
+            auto& top = red.back();
+            if (top._next < top._successors.size()) {
+                auto succ = top._successors[top._next++];
+                if (w._cyan.count(succ._id) > 0) {
+                    // closes a cycle through the accepting seed
+                    report(blue, &red, succ._id);
+                    return;
+                }
+                if (w._red.count(succ._id) > 0 || (_states.get_flags(succ._id, succ._data) & RED) != 0)
+                    continue;
+                w._red.emplace(succ._id, succ._data);
+                red.push_back(frame_t{succ._id, succ._data, {}, 0});
+                expand(w, red.back());
+            } else {
+                red.pop_back();
+            }
+        }
+        // accepting states met here may still be seeds of red searches in other threads
+        for (auto& [id, data] : w._red) {
+            if (id == seed._id || !is_accepting(id))
+                continue;
+            while ((_states.get_flags(id, data) & RED) == 0) {
+                if (_stop) return;
+                std::this_thread::yield();
+            }
+        }
+        for (auto& [id, data] : w._red)
+            _states.set_flags(id, data, RED);
+    }
+
+    void CNDFSModelChecker::report(const std::vector<frame_t>& blue, const std::vector<frame_t>* red, size_t loop_id)
+    {
+        std::lock_guard<std::mutex> lock(_report_lock);
+        _stop = true;
+        if (_violation)
+            return;
+        _violation = true;
+        if (!_build_trace)
+            return;
+        // the transitions leading to the next frame, the red search starts from the last blue frame
+        for (size_t i = 0; i + 1 < blue.size(); ++i) {
+            if (blue[i]._id == loop_id && _loop == std::numeric_limits<size_t>::max())
+                _loop = _trace.size();
+            _trace.push_back(blue[i]._successors[blue[i]._next - 1]._transition);
+        }
+        if (red == nullptr)
+            return;
+        if (blue.back()._id == loop_id && _loop == std::numeric_limits<size_t>::max())
+            _loop = _trace.size();
+        for (auto& frame : *red)
+            _trace.push_back(frame._successors[frame._next - 1]._transition);
+    }
+
+    void CNDFSModelChecker::print_stats(std::ostream &os) const
+    {
+        ModelChecker::print_stats(os, _states.discovered(), _states.max_tokens());
+        os << "\tthreads:           " << _threads << std::endl;
+    }
+}
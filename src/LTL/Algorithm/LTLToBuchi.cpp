@@ -22,6 +22,7 @@
 #include "PetriEngine/PQL/FormulaSize.h"
 
 #include <spot/twaalgos/translate.hh>
+#include <spot/twaalgos/ltl2taa.hh>
 #include <spot/tl/parse.hh>
 #include <spot/twa/bddprint.hh>
 #include <sstream>
@@ -281,6 +282,25 @@ namespace LTL {
     Structures::BuchiAutomaton make_buchi_automaton(const PetriEngine::PQL::Condition_ptr &query, BuchiOptimization optimization, APCompression compression) {
         auto [formula, apinfo] = to_spot_formula(query, compression);
         formula = spot::formula::Not(formula);
+        // bind PQL expressions to the atomic proposition IDs used by spot.
+        // the resulting map can be indexed using variables mentioned on edges of the created Büchi automaton.
+        auto bind_aps = [&apinfo = apinfo](const spot::twa_graph_ptr& automaton) {
+            std::unordered_map<int, AtomicProposition> ap_map;
+            for (const auto &info : apinfo) {
+                int varnum = automaton->register_ap(info._text);
+                ap_map[varnum] = info;
+            }
+            return ap_map;
+        };
+        if (optimization == BuchiOptimization::OnTheFly) {
+            // The tableau of ltl_to_taa is linear in the size of the formula, the exponential
+            // part is in its successors, which are only computed for the states the search reaches.
+            auto dict = spot::make_bdd_dict();
+            auto automaton = spot::make_twa_graph(dict);
+            auto on_the_fly = std::make_shared<Structures::OnTheFlyBuchi>(spot::ltl_to_taa(formula, dict), automaton);
+            auto ap_map = bind_aps(automaton);
+            return Structures::BuchiAutomaton{std::move(automaton), std::move(ap_map), std::move(on_the_fly)};
+        }
         spot::translator translator;
         // Ask for Büchi acceptance (rather than generalized Büchi) and medium optimizations
         // (default is high which causes many worst case BDD constructions i.e. exponential blow-up)
@@ -296,16 +316,13 @@ namespace LTL {
             case BuchiOptimization::High:
                 level = spot::postprocessor::High;
                 break;
+            default:
+                assert(false);
+                throw base_error("Unknown Büchi optimization level: ", to_underlying(optimization));
         }
         translator.set_level(level);
         spot::twa_graph_ptr automaton = translator.run(formula);
-        std::unordered_map<int, AtomicProposition> ap_map;
-        // bind PQL expressions to the atomic proposition IDs used by spot.
-        // the resulting map can be indexed using variables mentioned on edges of the created Büchi automaton.
-        for (const auto &info : apinfo) {
-            int varnum = automaton->register_ap(info._text);
-            ap_map[varnum] = info;
-        }
+        auto ap_map = bind_aps(automaton);
 
         return Structures::BuchiAutomaton{std::move(automaton), std::move(ap_map)};
     }
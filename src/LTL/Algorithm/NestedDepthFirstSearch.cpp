@@ -30,10 +30,12 @@ namespace LTL {
             gen.set_heuristic(_heuristic);
             ProductSuccessorGenerator prod_gen(_net, _buchi, gen);
             dfs(prod_gen);
+            _ap_evaluations = prod_gen.ap_evaluations();
         } else {
             ResumingSuccessorGenerator gen(_net);
             ProductSuccessorGenerator prod_gen(_net, _buchi, gen);
             dfs(prod_gen);
+            _ap_evaluations = prod_gen.ap_evaluations();
         }
         return !_violation;
     }
@@ -66,6 +68,7 @@ namespace LTL {
 
         State working = this->_factory.new_state();
         State curState = this->_factory.new_state();
+        successor_generator.set_valuation_cache(&_states.valuations());
 
         {
             auto initial_states = successor_generator.make_initial_state();
@@ -157,6 +160,7 @@ namespace LTL {
     void NestedDepthFirstSearch::print_stats(std::ostream &os) const
     {
         ModelChecker::print_stats(os, _states.discovered(), _states.max_tokens());
+        os << "\tAP evaluations:    " << _ap_evaluations << std::endl;
     }
 
 
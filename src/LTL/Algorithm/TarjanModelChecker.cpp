@@ -22,6 +22,7 @@ namespace LTL {
 
     void TarjanModelChecker::print_stats(std::ostream &os) const {
         ModelChecker::print_stats(os, _discoverd, _max_tokens);
+        os << "\tAP evaluations:    " << _ap_evaluations << std::endl;
     }
 
     void TarjanModelChecker::set_partial_order(LTLPartialOrder o)
@@ -96,6 +97,7 @@ namespace LTL {
                 plain_centry_t>;
 
         StateSet seen(_net, _k_bound);
+        successorGenerator.set_valuation_cache(&seen.valuations());
         // master list of state information.
         light_deque<centry_t> cstack;
         // depth-first search stack, contains current search path.
@@ -144,18 +146,9 @@ namespace LTL {
 
                 dtop._sucinfo._last_state = stateid;
 
-                // lookup successor in 'hash' table
-                auto marking = StateSet::get_marking_id(stateid);
-                auto suc_pos = _chash[hash(marking, StateSet::get_buchi_state(stateid))];
-                while (suc_pos != std::numeric_limits<idx_t>::max() && cstack[suc_pos]._stateid != stateid) {
-                    if constexpr (std::is_same<SuccGen, SpoolingSuccessorGenerator>::value) {
-                        if (cstack[suc_pos]._dstack && StateSet::get_marking_id(cstack[suc_pos]._stateid) == marking) {
-                            successorGenerator->generate_all(&parent, dtop._sucinfo);
-                        }
-                    }
-                    suc_pos = cstack[suc_pos]._next;
-                }
-                if (suc_pos != std::numeric_limits<idx_t>::max()) {
+                // lookup successor among the states on cstack
+                auto suc_pos = _chash.find(cstack, stateid);
+                if (suc_pos != NONE) {
                     if constexpr (std::is_same<SuccGen, SpoolingSuccessorGenerator>::value) {
                         if (cstack[suc_pos]._dstack) {
                             successorGenerator.generate_all(&parent, dtop._sucinfo);
@@ -192,6 +185,8 @@ namespace LTL {
         }
         _discoverd = seen.discovered();
         _max_tokens = seen.max_tokens();
+        _ap_evaluations = successorGenerator.ap_evaluations();
+        successorGenerator.set_valuation_cache(nullptr);
         return !_violation;
     }
 
@@ -202,9 +197,8 @@ namespace LTL {
     template<typename StateSet, typename T, typename D, typename S>
     void TarjanModelChecker::push(StateSet& s, light_deque<T>& cstack, light_deque<D>& dstack, S& successor_generator, State &state, size_t stateid) {
         const auto ctop = static_cast<idx_t>(cstack.size());
-        const auto h = hash(StateSet::get_marking_id(stateid), StateSet::get_buchi_state(stateid));
-        cstack.push_back(T{ctop, stateid, _chash[h]});
-        _chash[h] = ctop;
+        cstack.push_back(T{ctop, stateid});
+        _chash.insert(cstack, ctop);
         dstack.push_back(D{ctop});
         if (successor_generator.is_accepting(state)) {
             _astack.push_back(ctop);
@@ -243,9 +237,8 @@ namespace LTL {
     template<typename StateSet, typename T>
     void TarjanModelChecker::popCStack(StateSet& s, light_deque<T>& cstack)
     {
-        auto h = hash(StateSet::get_marking_id(cstack.back()._stateid), StateSet::get_buchi_state(cstack.back()._stateid));
         _store.insert(cstack.back()._stateid);
-        _chash[h] = cstack.back()._next;
+        _chash.erase(cstack, cstack.back()._stateid);
         cstack.pop_back();
     }
 
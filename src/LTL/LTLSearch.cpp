@@ -23,6 +23,7 @@
 #include "LTL/SuccessorGeneration/SpoolingSuccessorGenerator.h"
 #include "LTL/Algorithm/NestedDepthFirstSearch.h"
 #include "LTL/Algorithm/TarjanModelChecker.h"
+#include "LTL/Algorithm/CNDFSModelChecker.h"
 
 #include "PetriEngine/PQL/PredicateCheckers.h"
 #include "PetriEngine/PQL/PQL.h"
@@ -103,6 +104,11 @@ namespace LTL {
             case LTLHeuristic::Distance:
                 return std::make_unique<DistanceHeuristic>(&net, negated_formula);
             case LTLHeuristic::Automaton:
+                // the automaton heuristic needs the distances over the whole automaton
+                if (automaton.is_on_the_fly()) {
+                    std::cerr << "Warning: the automaton heuristic is not supported with an on the fly Büchi automaton, using the distance heuristic" << std::endl;
+                    return std::make_unique<DistanceHeuristic>(&net, negated_formula);
+                }
                 return std::make_unique<AutomatonHeuristic>(&net, automaton);
             case LTLHeuristic::FireCount:
                 return std::make_unique<LogFireCountHeuristic>(net.numberOfTransitions(), 5000);
@@ -197,7 +203,8 @@ namespace LTL {
                             const Strategy search_strategy,
                             const LTLHeuristic heuristics_flag,
                             const bool utilize_weak,
-                            const uint64_t seed) {
+                            const uint64_t seed,
+                            const uint32_t threads) {
 
         _heuristic = make_heuristic(_net, _negated_formula, _buchi, search_strategy, heuristics_flag, seed);
 
@@ -210,11 +217,15 @@ namespace LTL {
             case Algorithm::Tarjan:
                 _checker = std::make_unique<TarjanModelChecker>(_net, _negated_formula, _buchi, k_bound);
                 break;
+            case Algorithm::CNDFS:
+                _checker = std::make_unique<CNDFSModelChecker>(_net, _negated_formula, _buchi, k_bound, threads, seed);
+                break;
             case Algorithm::None:
             default:
                 assert(false);
                 std::cerr << "Error: cannot LTL verify with algorithm None";
         }
+        _checker->set_tracing(trace);
         _checker->set_utilize_weak(utilize_weak);
         _checker->set_heuristic(_heuristic.get());
         _checker->set_partial_order(por);
@@ -42,9 +42,11 @@ private:
 namespace LTL {
     AutomatonHeuristic::AutomatonHeuristic(const PetriEngine::PetriNet *net,
                                                            const Structures::BuchiAutomaton &aut)
-            : _net(net), _aut(aut), _bfs_dists(aut.buchi().num_states())
+            : _net(net), _aut(aut)
     {
+        // expands an automaton built on the fly, the distances need all of it
         _state_guards = std::move(guard_info_t::from_automaton(_aut));
+        _bfs_dists.resize(_aut.buchi().num_states());
 
         ReachDistance bfs_calc(_aut.buchi_ptr());
         for (unsigned state = 0; state < _aut.buchi().num_states(); ++state) {
@@ -0,0 +1,115 @@
+#include "PetriEngine/IncrementalSuccessorGenerator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace PetriEngine {
+
+    IncrementalSuccessorGenerator::IncrementalSuccessorGenerator(const PetriNet &net)
+            : SuccessorGenerator(net), _stamps(net.numberOfTransitions(), 0) {
+        // count the readers of each place, then fill them in as a flat array
+        _consumerPtrs.resize(net.numberOfPlaces() + 1, 0);
+        for (uint32_t t = 0; t < net.numberOfTransitions(); ++t) {
+            auto [finv, linv] = net.preset(t);
+            for (; finv != linv; ++finv)
+                ++_consumerPtrs[finv->place + 1];
+        }
+        for (uint32_t p = 0; p < net.numberOfPlaces(); ++p)
+            _consumerPtrs[p + 1] += _consumerPtrs[p];
+        _consumers.resize(_consumerPtrs.back());
+        std::vector<uint32_t> fill(_consumerPtrs.begin(), _consumerPtrs.end() - 1);
+        for (uint32_t t = 0; t < net.numberOfTransitions(); ++t) {
+            auto [finv, linv] = net.preset(t);
+            for (; finv != linv; ++finv)
+                _consumers[fill[finv->place]++] = t;
+        }
+    }
+
+    IncrementalSuccessorGenerator::IncrementalSuccessorGenerator(const PetriNet &net,
+                                                                 std::vector<std::shared_ptr<PQL::Condition> > &)
+            : IncrementalSuccessorGenerator(net) {
+    }
+
+    bool IncrementalSuccessorGenerator::prepare(const Structures::State *state) {
+        _parent = state;
+        reset();
+        _index = 0;
+        _enabled.clear();
+        // same scan as SuccessorGenerator::next, transitions are grouped by a pre-place
+        for (uint32_t p = 0; p < _net._nplaces; ++p) {
+            // orphans are currently under "place 0" as a special case
+            if (p != 0 && (*_parent).marking()[p] == 0) continue;
+            uint32_t last = _net._placeToPtrs[p + 1];
+            for (uint32_t t = _net._placeToPtrs[p]; t != last; ++t) {
+                if (checkPreset(t))
+                    _enabled.push_back(t);
+            }
+        }
+        return true;
+    }
+
+    bool IncrementalSuccessorGenerator::prepare(const Structures::State *state, const std::vector<uint32_t>& parent,
+                                                uint32_t fired) {
+        _parent = state;
+        reset();
+        _index = 0;
+        _update(parent, fired, _enabled);
+        return true;
+    }
+
+    bool IncrementalSuccessorGenerator::prepareSuccessor(const Structures::State *state, uint32_t fired) {
+        _parent = state;
+        reset();
+        _index = 0;
+        _update(_enabled, fired, _scratch);
+        _enabled.swap(_scratch);
+        return true;
+    }
+
+    void IncrementalSuccessorGenerator::_update(const std::vector<uint32_t>& parent, uint32_t fired,
+                                                std::vector<uint32_t>& result) {
+        if (++_stamp == 0) {
+            std::fill(_stamps.begin(), _stamps.end(), 0);
+            _stamp = 1;
+        }
+
+        // re-evaluate everything reading a place in the pre- or postset of fired
+        result.clear();
+        auto touch = [&](const Invariant* finv, const Invariant* linv) {
+            for (; finv != linv; ++finv) {
+                uint32_t last = _consumerPtrs[finv->place + 1];
+                for (uint32_t i = _consumerPtrs[finv->place]; i != last; ++i) {
+                    uint32_t t = _consumers[i];
+                    if (_stamps[t] == _stamp) continue;
+                    _stamps[t] = _stamp;
+                    if (checkPreset(t))
+                        result.push_back(t);
+                }
+            }
+        };
+        auto pre = _net.preset(fired);
+        touch(pre.first, pre.second);
+        auto post = _net.postset(fired);
+        touch(post.first, post.second);
+        std::sort(result.begin(), result.end());
+
+        // the remaining transitions keep their status from the parent
+        size_t changed = result.size();
+        for (auto t : parent) {
+            if (_stamps[t] != _stamp)
+                result.push_back(t);
+        }
+        std::inplace_merge(result.begin(), result.begin() + changed, result.end());
+        assert(std::adjacent_find(result.begin(), result.end()) == result.end());
+    }
+
+    bool IncrementalSuccessorGenerator::next(Structures::State &write) {
+        if (_index == _enabled.size())
+            return false;
+        uint32_t t = _enabled[_index++];
+        _fire(write, t);
+        // keep fired() of the base class working
+        _suc_tcounter = t + 1;
+        return true;
+    }
+}
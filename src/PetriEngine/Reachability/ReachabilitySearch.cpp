@@ -84,6 +84,7 @@ namespace PetriEngine {
         {
             std::cout   << "STATS:\n"
                         << "\tdiscovered states: " << states->discovered() << std::endl
+                        << "\tdiscovery rate:    " << (size_t)states->discoveryRate() << " states/s" << std::endl
                         << "\texplored states:   " << ss.exploredStates << std::endl
                         << "\texpanded states:   " << ss.expandedStates << std::endl
                         << "\tmax tokens:        " << states->maxTokens() << std::endl;
@@ -116,10 +117,20 @@ namespace PetriEngine {
         }
 
 #define TRYREACHPAR    (queries, results, usequeries, printstats, seed)
-#define TEMPPAR(X, Y)  if(keep_trace) return tryReach<X, Structures::TracableStateSet, Y>TRYREACHPAR ; \
+#define TEMPPAR(X, Y)  if(keep_trace && tracecheckpoint > 1) return tryReach<X, Structures::DeltaStateSet, Y>TRYREACHPAR ; \
+                       else if(keep_trace) return tryReach<X, Structures::TracableStateSet, Y>TRYREACHPAR ; \
                        else return tryReach<X, Structures::StateSet, Y> TRYREACHPAR;
-#define TRYREACH(X)    if(stubbornreduction) TEMPPAR(X, ReducingSuccessorGenerator) \
-                       else TEMPPAR(X, SuccessorGenerator)
+// the stubborn sets annotate the (shared) queries while computing, so parallel search uses full expansion
+#define PARPAR(P, W)   if(threads > 1 || !stubbornreduction) \
+                           return tryReachParallel<P, W, SuccessorGenerator>(queries, results, usequeries, printstats, keep_trace, seed); \
+                       else return tryReachParallel<P, W, ReducingSuccessorGenerator>(queries, results, usequeries, printstats, keep_trace, seed);
+#define TRYREACH(X, P) if(store == StateStore::Hash) { PARPAR(P, Structures::HashStateSet) } \
+                       else if(store == StateStore::Bitstate) { \
+                           if(stubbornreduction) return tryReach<X, Structures::BitStateSet, ReducingSuccessorGenerator>TRYREACHPAR; \
+                           else return tryReach<X, Structures::BitStateSet, IncrementalSuccessorGenerator>TRYREACHPAR; } \
+                       else if(threads > 1) return tryReachParallel<P, Structures::ConcurrentStateSet, SuccessorGenerator>(queries, results, usequeries, printstats, keep_trace, seed); \
+                       else if(stubbornreduction) TEMPPAR(X, ReducingSuccessorGenerator) \
+                       else TEMPPAR(X, IncrementalSuccessorGenerator)
 
 
         bool ReachabilitySearch::reachable(
@@ -130,9 +141,19 @@ namespace PetriEngine {
                     bool statespacesearch,
                     bool printstats,
                     bool keep_trace,
-                    size_t seed)
+                    size_t seed,
+                    const StoreOptions& storeoptions)
         {
             bool usequeries = !statespacesearch;
+            const auto threads = storeoptions.threads;
+            const auto store = storeoptions.store;
+            const auto tracecheckpoint = storeoptions.tracecheckpoint;
+            if(storeoptions.memorylimit != 0 && (keep_trace || threads > 1 || store != StateStore::PTrie))
+                throw base_error("The memory limit is only supported by the sequential search with the ptrie state store and without traces");
+            if(store == StateStore::Bitstate && (keep_trace || threads > 1))
+                throw base_error("The bitstate state store is only supported by the sequential search without traces");
+            // the parallel stores encode with one encoder per worker and ignore adaptiveencoding
+            _store = storeoptions;
 
             // if we are searching for bounds
             if(!usequeries) strategy = Strategy::BFS;
@@ -140,16 +161,16 @@ namespace PetriEngine {
             switch(strategy)
             {
                 case Strategy::DFS:
-                    TRYREACH(DFSQueue)
+                    TRYREACH(DFSQueue, DFSStealingQueue)
                     break;
                 case Strategy::BFS:
-                    TRYREACH(BFSQueue)
+                    TRYREACH(BFSQueue, BFSStealingQueue)
                     break;
                 case Strategy::HEUR:
-                    TRYREACH(HeuristicQueue)
+                    TRYREACH(HeuristicQueue, HeuristicStealingQueue)
                     break;
                 case Strategy::RDFS:
-                    TRYREACH(RDFSQueue)
+                    TRYREACH(RDFSQueue, RDFSStealingQueue)
                     break;
                 default:
                     throw base_error("Unsupported search strategy");
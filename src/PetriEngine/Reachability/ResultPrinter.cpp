@@ -3,6 +3,7 @@
 #include "PetriEngine/PetriNetBuilder.h"
 #include "PetriEngine/options.h"
 #include "PetriEngine/PQL/Expressions.h"
+#include "PetriEngine/Structures/BitStateSet.h"
 
 namespace PetriEngine {
     namespace Reachability {
@@ -56,6 +57,19 @@ namespace PetriEngine {
                 std::cout << std::endl;
             }
 
+            // an exhausted bitstate search may have pruned markings by hash collisions
+            if(result == NotSatisfied && dynamic_cast<Structures::BitStateSet*>(stateset) != nullptr)
+            {
+                if(!options->statespaceexploration)
+                {
+                    std::cout << "\nUnable to decide if " << querynames[index] << " is satisfied.\n";
+                    std::cout << "The bitstate search may be incomplete.\n\n";
+                    std::cout << "Query is MAYBE satisfied.\n" << std::endl;
+                    return std::make_pair(Ignore,false);
+                }
+                std::cout << "The bitstate search may be incomplete, the state space statistics are lower bounds." << std::endl;
+            }
+
             bool showTrace = (result == Satisfied);
 
             if(!options->statespaceexploration && retval != Unknown)
@@ -188,6 +202,10 @@ namespace PetriEngine {
                 {
                     out += "STUBBORN_SETS ";
                 }
+                if(options->statestore == StateStore::Bitstate)
+                {
+                    out += "BITSTATE_HASHING ";
+                }
             }
             if(options->tar)
             {
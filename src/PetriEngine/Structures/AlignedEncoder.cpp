@@ -5,12 +5,16 @@
  * Created on 11 March 2016, 14:15
  */
 
+#include <algorithm>
 #include <limits>
 
 #include "PetriEngine/Structures/AlignedEncoder.h"
 
 #define SAMEBOUND 120
 #define DBOUND (SAMEBOUND*2)
+#define PACKED (DBOUND+11)
+// the generation is stored in a single byte
+#define MAXGENERATIONS 255
 
 AlignedEncoder::AlignedEncoder(uint32_t places, uint32_t k)
 : _places(places)
@@ -345,6 +349,130 @@ uint32_t AlignedEncoder::readBitVector(uint32_t* destination, const unsigned cha
     return offset + b.size();
 }
 
+size_t AlignedEncoder::writePacked(size_t offset, const uint32_t* data, size_t generation)
+{
+    const uint8_t* widths = &_widths[generation*_places];
+    unsigned char* dest = &_scratchpad.raw()[offset];
+    uint64_t acc = 0;
+    uint32_t nbits = 0;
+    for(size_t i = 0; i < _places; ++i)
+    {
+        acc |= ((uint64_t)data[i]) << nbits;
+        nbits += widths[i];
+        while(nbits >= 8)
+        {
+            *dest++ = (unsigned char)acc;
+            acc >>= 8;
+            nbits -= 8;
+        }
+    }
+    if(nbits > 0)
+        *dest = (unsigned char)acc;
+    return offset + scratchpad_t::bytes(_generationBits[generation]);
+}
+
+void AlignedEncoder::readPacked(uint32_t* destination, const unsigned char* source, uint32_t offset, size_t generation) const
+{
+    const uint8_t* widths = &_widths[generation*_places];
+    const unsigned char* src = &source[offset];
+    uint64_t acc = 0;
+    uint32_t nbits = 0;
+    for(size_t i = 0; i < _places; ++i)
+    {
+        while(nbits < widths[i])
+        {
+            acc |= ((uint64_t)*src++) << nbits;
+            nbits += 8;
+        }
+        destination[i] = (uint32_t)(acc & ((uint64_t{1} << widths[i]) - 1));
+        acc >>= widths[i];
+        nbits -= widths[i];
+    }
+}
+
+size_t AlignedEncoder::typeSize(unsigned char type, uint32_t pwt) const
+{
+    if(type <= SAMEBOUND)
+        return 1 + scratchpad_t::bytes(_places);
+    if(type <= DBOUND)
+        return 1 + _psize + pwt*_psize;
+    switch(type)
+    {
+        case DBOUND+1:
+            return 1 + scratchpad_t::bytes(_places*2);
+        case DBOUND+2:
+        case DBOUND+3:
+        case DBOUND+4:
+            return 1 + _places*(1 << (type - DBOUND - 2));
+        case DBOUND+5:
+        case DBOUND+6:
+        case DBOUND+7:
+            return 1 + _psize + pwt*(_psize + (1 << (type - DBOUND - 5)));
+        case DBOUND+8:
+        case DBOUND+9:
+        case DBOUND+10:
+            return 1 + scratchpad_t::bytes(_places) + pwt*(1 << (type - DBOUND - 8));
+        default:
+            assert(false);
+            return std::numeric_limits<size_t>::max();
+    }
+}
+
+size_t AlignedEncoder::encodeAdaptive(const uint32_t* d, unsigned char type)
+{
+    _needed.resize(_places);
+    uint32_t pwt = 0;
+    for(size_t i = 0; i < _places; ++i)
+    {
+        // widths are rounded to 1, 2, 4, 8, 16 or 32 bits to keep the generations few
+        uint8_t bits = 1;
+        while(bits < 32 && (d[i] >> bits) != 0)
+            bits *= 2;
+        _needed[i] = bits;
+        pwt += d[i] > 0;
+    }
+
+    // the widths grow with the generations, so the generations a marking fits are a suffix
+    auto fits = [this](size_t generation) {
+        const uint8_t* widths = &_widths[generation*_places];
+        for(size_t i = 0; i < _places; ++i)
+            if(_needed[i] > widths[i]) return false;
+        return true;
+    };
+    size_t lo = 0, hi = _generationBits.size();
+    while(lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if(fits(mid)) hi = mid;
+        else lo = mid + 1;
+    }
+
+    size_t generation = lo;
+    if(generation == _generationBits.size())
+    {
+        if(generation == MAXGENERATIONS)
+            return encodeFixed(d, type);
+        _widths.insert(_widths.end(), _needed.begin(), _needed.end());
+        uint8_t* widths = &_widths[generation*_places];
+        const uint8_t* previous = generation > 0 ? widths - _places : widths;
+        size_t bits = 0;
+        for(size_t i = 0; i < _places; ++i)
+        {
+            widths[i] = std::max(widths[i], previous[i]);
+            bits += widths[i];
+        }
+        _generationBits.push_back(bits);
+    }
+
+    if(2 + scratchpad_t::bytes(_generationBits[generation]) >= typeSize(type, pwt))
+        return encodeFixed(d, type);
+
+    _scratchpad.zero();
+    _scratchpad.raw()[0] = PACKED;
+    _scratchpad.raw()[1] = (unsigned char)generation;
+    return writePacked(2, d, generation);
+}
+
 unsigned char AlignedEncoder::getType(uint32_t sum, uint32_t pwt, bool same, uint32_t val) const
 {
     if(pwt == 0) return 0;
@@ -455,6 +583,8 @@ size_t AlignedEncoder::size(const uchar* s) const
     
     switch(type)
     {
+        case PACKED:
+            return 2 + scratchpad_t::bytes(_generationBits[s[1]]);
         case DBOUND+1:
             if((_places % 4) == 0) return 1 + (_places / 4);
             else return 2 + (_places / 4);
@@ -483,6 +613,13 @@ size_t AlignedEncoder::size(const uchar* s) const
 }
 
 size_t AlignedEncoder::encode(const uint32_t* d, unsigned char type)
+{
+    if(_adaptive)
+        return encodeAdaptive(d, type);
+    return encodeFixed(d, type);
+}
+
+size_t AlignedEncoder::encodeFixed(const uint32_t* d, unsigned char type)
 {
     _scratchpad.zero();
     _scratchpad.raw()[0] = type;
@@ -559,6 +696,9 @@ void AlignedEncoder::decode(uint32_t* d, const unsigned char* s)
     
     switch(type)
     {
+        case PACKED:
+            readPacked(d, s, 2, s[1]);
+            return;
         case DBOUND+1:
             readTwoBitVector(d,s,1);
             return;
@@ -0,0 +1,160 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PetriEngine/Structures/MarkingKernels.h"
+
+#include <algorithm>
+#include <limits>
+
+// the vector kernels are compiled for their target only, the static build
+// selects between them at runtime and thus still runs on any x86-64.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define VERIFYPN_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define VERIFYPN_X86_KERNELS 0
+#endif
+
+namespace PetriEngine {
+    namespace Structures {
+        namespace {
+            using stats_fn = marking_stats_t (*)(const uint32_t*, size_t);
+
+            void scalarTail(const uint32_t* marking, size_t from, size_t nplaces,
+                            marking_stats_t& r, uint32_t& min)
+            {
+                for (size_t i = from; i < nplaces; ++i)
+                {
+                    uint32_t v = marking[i];
+                    if (v == 0) continue;
+                    r.sum += v;
+                    ++r.active;
+                    r.last = i;
+                    r.max = std::max(r.max, v);
+                    min = std::min(min, v);
+                }
+            }
+
+            marking_stats_t statsScalar(const uint32_t* marking, size_t nplaces)
+            {
+                marking_stats_t r;
+                uint32_t min = std::numeric_limits<uint32_t>::max();
+                scalarTail(marking, 0, nplaces, r, min);
+                r.allsame = r.active == 0 || min == r.max;
+                return r;
+            }
+
+#if VERIFYPN_X86_KERNELS
+            __attribute__((target("sse4.1")))
+            marking_stats_t statsSSE41(const uint32_t* marking, size_t nplaces)
+            {
+                marking_stats_t r;
+                const __m128i zero = _mm_setzero_si128();
+                __m128i vmax = zero;
+                // zeros are or'ed to all ones, so they never become the minimum
+                __m128i vmin = _mm_set1_epi32(-1);
+                __m128i vsum = zero;
+                size_t i = 0;
+                for (; i + 4 <= nplaces; i += 4)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(marking + i));
+                    __m128i isZero = _mm_cmpeq_epi32(v, zero);
+                    unsigned nonzero = ~_mm_movemask_ps(_mm_castsi128_ps(isZero)) & 0xF;
+                    if (nonzero == 0) continue;
+                    r.active += __builtin_popcount(nonzero);
+                    r.last = i + (31 - __builtin_clz(nonzero));
+                    vmax = _mm_max_epu32(vmax, v);
+                    vmin = _mm_min_epu32(vmin, _mm_or_si128(v, isZero));
+                    vsum = _mm_add_epi64(vsum, _mm_cvtepu32_epi64(v));
+                    vsum = _mm_add_epi64(vsum, _mm_cvtepu32_epi64(_mm_srli_si128(v, 8)));
+                }
+                alignas(16) uint32_t maxs[4], mins[4];
+                alignas(16) uint64_t sums[2];
+                _mm_store_si128(reinterpret_cast<__m128i*>(maxs), vmax);
+                _mm_store_si128(reinterpret_cast<__m128i*>(mins), vmin);
+                _mm_store_si128(reinterpret_cast<__m128i*>(sums), vsum);
+                uint32_t min = std::numeric_limits<uint32_t>::max();
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    r.max = std::max(r.max, maxs[j]);
+                    min = std::min(min, mins[j]);
+                }
+                r.sum = sums[0] + sums[1];
+                scalarTail(marking, i, nplaces, r, min);
+                r.allsame = r.active == 0 || min == r.max;
+                return r;
+            }
+
+            __attribute__((target("avx2")))
+            marking_stats_t statsAVX2(const uint32_t* marking, size_t nplaces)
+            {
+                marking_stats_t r;
+                const __m256i zero = _mm256_setzero_si256();
+                __m256i vmax = zero;
+                __m256i vmin = _mm256_set1_epi32(-1);
+                __m256i vsum = zero;
+                size_t i = 0;
+                for (; i + 8 <= nplaces; i += 8)
+                {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(marking + i));
+                    __m256i isZero = _mm256_cmpeq_epi32(v, zero);
+                    unsigned nonzero = ~_mm256_movemask_ps(_mm256_castsi256_ps(isZero)) & 0xFF;
+                    if (nonzero == 0) continue;
+                    r.active += __builtin_popcount(nonzero);
+                    r.last = i + (31 - __builtin_clz(nonzero));
+                    vmax = _mm256_max_epu32(vmax, v);
+                    vmin = _mm256_min_epu32(vmin, _mm256_or_si256(v, isZero));
+                    vsum = _mm256_add_epi64(vsum, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+                    vsum = _mm256_add_epi64(vsum, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1)));
+                }
+                alignas(32) uint32_t maxs[8], mins[8];
+                alignas(32) uint64_t sums[4];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(maxs), vmax);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(mins), vmin);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(sums), vsum);
+                uint32_t min = std::numeric_limits<uint32_t>::max();
+                for (size_t j = 0; j < 8; ++j)
+                {
+                    r.max = std::max(r.max, maxs[j]);
+                    min = std::min(min, mins[j]);
+                }
+                r.sum = sums[0] + sums[1] + sums[2] + sums[3];
+                scalarTail(marking, i, nplaces, r, min);
+                r.allsame = r.active == 0 || min == r.max;
+                return r;
+            }
+#endif
+
+            stats_fn selectStats()
+            {
+#if VERIFYPN_X86_KERNELS
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2"))
+                    return &statsAVX2;
+                if (__builtin_cpu_supports("sse4.1"))
+                    return &statsSSE41;
+#endif
+                return &statsScalar;
+            }
+        }
+
+        marking_stats_t markingStats(const uint32_t* marking, size_t nplaces)
+        {
+            static const stats_fn kernel = selectStats();
+            return kernel(marking, nplaces);
+        }
+    }
+}
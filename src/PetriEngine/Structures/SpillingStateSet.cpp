@@ -0,0 +1,269 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PetriEngine/Structures/SpillingStateSet.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+namespace PetriEngine {
+    namespace Structures {
+
+        namespace {
+            bool recordLess(const ptrie::uchar* a, uint16_t alength, const ptrie::uchar* b, uint16_t blength)
+            {
+                if(alength != blength) return alength < blength;
+                return memcmp(a, b, alength) < 0;
+            }
+
+            uint16_t recordLength(const ptrie::uchar* record)
+            {
+                uint16_t length;
+                memcpy(&length, record, sizeof(uint16_t));
+                return length;
+            }
+        }
+
+        SpillingStateSet::SpillingStateSet(const PetriNet& net, uint32_t kbound, size_t memorylimit)
+        : StateSetInterface(net, kbound), _memorylimit(memorylimit),
+          _visited(nullptr, &fclose), _frontier(_tmpfile()), _next(nullptr, &fclose)
+        {
+        }
+
+        void SpillingStateSet::inherit(const StateSetInterface& states)
+        {
+            _discovered = states.discovered();
+            _maxTokens = states.maxTokens();
+            _maxPlaceBound = states.maxPlaceBound();
+        }
+
+        void SpillingStateSet::addVisited(const State& state)
+        {
+            _append(state);
+        }
+
+        void SpillingStateSet::addFrontier(const State& state)
+        {
+            auto length = _encode(state);
+            if(length == 0) return;
+            _write(_frontier.get(), _encoder.scratchpad().const_raw(), length);
+            ++_frontierSize;
+        }
+
+        void SpillingStateSet::seal()
+        {
+            State dummy;
+            _merge(dummy, nullptr);
+            rewind(_frontier.get());
+        }
+
+        std::pair<bool, size_t> SpillingStateSet::add(const State& state)
+        {
+            _discovered++;
+
+            MarkVal sum = 0;
+            bool allsame = true;
+            uint32_t val = 0;
+            uint32_t active = 0;
+            uint32_t last = 0;
+            markingStats(state.marking(), sum, allsame, val, active, last);
+
+            if (_maxTokens < sum)
+                _maxTokens = sum;
+
+            //Check that we're within k-bound
+            if (_kbound != 0 && sum > _kbound)
+                return std::pair<bool, size_t>(false, std::numeric_limits<size_t>::max());
+
+            // every marking added is reachable, so the bounds are sound even
+            // if the marking turns out to be a duplicate later on.
+            for (uint32_t i = 0; i < _net.numberOfPlaces(); i++)
+            {
+                _maxPlaceBound[i] = std::max<MarkVal>( state.marking()[i],
+                                                        _maxPlaceBound[i]);
+            }
+
+            _append(state);
+            return std::pair<bool, size_t>(true, std::numeric_limits<size_t>::max());
+        }
+
+        bool SpillingStateSet::nextFrontier(State& state)
+        {
+            if(!_read(_frontier.get(), _record))
+                return false;
+            _encoder.decode(state.marking(), _record.data());
+            return true;
+        }
+
+        bool SpillingStateSet::nextLayer(State& state, const std::function<bool(State&)>& onNew)
+        {
+            return _merge(state, &onNew);
+        }
+
+        size_t SpillingStateSet::_encode(const State& state)
+        {
+            MarkVal sum = 0;
+            bool allsame = true;
+            uint32_t val = 0;
+            uint32_t active = 0;
+            uint32_t last = 0;
+            markingStats(state.marking(), sum, allsame, val, active, last);
+            if (_kbound != 0 && sum > _kbound)
+                return 0;
+
+            unsigned char type = _encoder.getType(sum, active, allsame, val);
+            size_t length = _encoder.encode(state.marking(), type);
+            if(length >= std::numeric_limits<uint16_t>::max())
+                throw base_error("Marking could not be encoded into less than 2^16 bytes, current limit of the spilling state store");
+            return length;
+        }
+
+        void SpillingStateSet::_append(const State& state)
+        {
+            uint16_t length = _encode(state);
+            if(length == 0) return;
+            _offsets.push_back(_buffer.size());
+            auto* length_bytes = reinterpret_cast<const ptrie::uchar*>(&length);
+            _buffer.insert(_buffer.end(), length_bytes, length_bytes + sizeof(uint16_t));
+            auto* data = _encoder.scratchpad().const_raw();
+            _buffer.insert(_buffer.end(), data, data + length);
+            if(memoryUsage() >= _memorylimit)
+                _spill();
+        }
+
+        void SpillingStateSet::_spill()
+        {
+            if(_offsets.empty()) return;
+            const ptrie::uchar* buffer = _buffer.data();
+            std::sort(_offsets.begin(), _offsets.end(), [buffer](size_t a, size_t b) {
+                return recordLess(buffer + a + sizeof(uint16_t), recordLength(buffer + a),
+                                  buffer + b + sizeof(uint16_t), recordLength(buffer + b));
+            });
+
+            auto run = _tmpfile();
+            const ptrie::uchar* prev = nullptr;
+            uint16_t prevlength = 0;
+            for(auto offset : _offsets)
+            {
+                auto length = recordLength(buffer + offset);
+                auto* data = buffer + offset + sizeof(uint16_t);
+                // the run is sorted, so duplicates within it are adjacent
+                if(prev != nullptr && prevlength == length && memcmp(prev, data, length) == 0)
+                    continue;
+                _write(run.get(), data, length);
+                prev = data;
+                prevlength = length;
+            }
+            _runs.emplace_back(std::move(run));
+            _buffer.clear();
+            _offsets.clear();
+            ++_spills;
+        }
+
+        bool SpillingStateSet::_merge(State& state, const std::function<bool(State&)>* onNew)
+        {
+            _spill();
+
+            // the visited file (if any) is input 0, then the runs of this layer.
+            std::vector<FILE*> inputs;
+            bool hasvisited = _visited != nullptr;
+            if(hasvisited)
+                inputs.push_back(_visited.get());
+            for(auto& run : _runs)
+                inputs.push_back(run.get());
+
+            std::vector<std::vector<ptrie::uchar>> heads(inputs.size());
+            auto greater = [&heads](size_t a, size_t b) {
+                return recordLess(heads[b].data(), heads[b].size(), heads[a].data(), heads[a].size());
+            };
+            std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+            for(size_t i = 0; i < inputs.size(); ++i)
+            {
+                rewind(inputs[i]);
+                if(_read(inputs[i], heads[i]))
+                    heap.push(i);
+            }
+
+            auto visited = _tmpfile();
+            if(onNew) _next = _tmpfile();
+            size_t fresh = 0;
+            while(!heap.empty())
+            {
+                auto i = heap.top();
+                heap.pop();
+                bool seen = hasvisited && i == 0;
+                std::swap(_record, heads[i]);
+                if(_read(inputs[i], heads[i]))
+                    heap.push(i);
+                while(!heap.empty() && heads[heap.top()] == _record)
+                {
+                    auto j = heap.top();
+                    heap.pop();
+                    seen |= hasvisited && j == 0;
+                    if(_read(inputs[j], heads[j]))
+                        heap.push(j);
+                }
+
+                _write(visited.get(), _record.data(), _record.size());
+                if(seen || onNew == nullptr)
+                    continue;
+
+                _write(_next.get(), _record.data(), _record.size());
+                ++fresh;
+                _encoder.decode(state.marking(), _record.data());
+                if((*onNew)(state))
+                    return true;
+            }
+
+            _visited = std::move(visited);
+            _runs.clear();
+            if(onNew)
+            {
+                _frontier = std::move(_next);
+                _frontierSize = fresh;
+                rewind(_frontier.get());
+            }
+            return false;
+        }
+
+        SpillingStateSet::file_t SpillingStateSet::_tmpfile()
+        {
+            file_t file(std::tmpfile(), &fclose);
+            if(file == nullptr)
+                throw base_error("Could not create a temporary file for spilling the state space");
+            return file;
+        }
+
+        void SpillingStateSet::_write(FILE* file, const ptrie::uchar* data, uint16_t length)
+        {
+            if(fwrite(&length, sizeof(uint16_t), 1, file) != 1 ||
+               fwrite(data, 1, length, file) != length)
+                throw base_error("Could not write the spilled state space to disk");
+        }
+
+        bool SpillingStateSet::_read(FILE* file, std::vector<ptrie::uchar>& record)
+        {
+            uint16_t length;
+            if(fread(&length, sizeof(uint16_t), 1, file) != 1)
+                return false;
+            record.resize(length);
+            if(fread(record.data(), 1, length, file) != length)
+                throw base_error("Could not read the spilled state space from disk");
+            return true;
+        }
+    }
+}
@@ -0,0 +1,265 @@
+/* VerifyPN - TAPAAL Petri Net Engine
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PetriEngine/Structures/StealingQueue.h"
+#include "PetriEngine/PQL/Contexts.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace PetriEngine {
+    namespace Structures {
+        StealingQueue::StealingQueue(size_t, uint32_t workers)
+        : _workers(std::max<uint32_t>(workers, 1)), _active(_workers, 0)
+        {
+            for(uint32_t i = 0; i < _workers; ++i)
+                _locks.emplace_back(std::make_unique<std::mutex>());
+        }
+
+        StealingQueue::~StealingQueue() {
+        }
+
+        void StealingQueue::push(uint32_t worker, size_t id, PQL::DistanceContext* context,
+            const PQL::Condition* query)
+        {
+            ++_pending;
+            ++_unfinished;
+            std::lock_guard<std::mutex> lk(lock(worker));
+            _push(worker, id, context, query);
+        }
+
+        size_t StealingQueue::pop(uint32_t worker)
+        {
+            // the state handed out last time has been expanded
+            if(_active[worker])
+            {
+                _active[worker] = 0;
+                --_unfinished;
+            }
+            uint32_t idle = 0;
+            while(!_aborted)
+            {
+                {
+                    std::lock_guard<std::mutex> lk(lock(worker));
+                    auto id = _pop(worker);
+                    if(id != EMPTY)
+                    {
+                        --_pending;
+                        _active[worker] = 1;
+                        return id;
+                    }
+                }
+                for(uint32_t attempt = 0; attempt < _workers; ++attempt)
+                {
+                    auto victim = _victim(worker, attempt);
+                    if(victim == worker) continue;
+                    std::unique_lock<std::mutex> lk(lock(victim), std::try_to_lock);
+                    if(!lk.owns_lock()) continue;
+                    auto id = _steal(worker, victim);
+                    if(id != EMPTY)
+                    {
+                        --_pending;
+                        ++_steals;
+                        _active[worker] = 1;
+                        return id;
+                    }
+                }
+                // every state pushed has been expanded, so nothing can be pushed anymore.
+                if(_unfinished == 0)
+                    return EMPTY;
+                // back off, from a few yields up to short sleeps
+                if(idle < 8)
+                {
+                    for(uint32_t i = 0; i < (1u << idle); ++i)
+                        std::this_thread::yield();
+                    ++idle;
+                }
+                else
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            return EMPTY;
+        }
+
+        uint32_t StealingQueue::_victim(uint32_t thief, uint32_t attempt)
+        {
+            return (thief + attempt + 1) % _workers;
+        }
+
+        BFSStealingQueue::BFSStealingQueue(size_t seed, uint32_t workers)
+        : StealingQueue(seed, workers), _queues(std::max<uint32_t>(workers, 1)) {}
+
+        void BFSStealingQueue::_push(uint32_t worker, size_t id, PQL::DistanceContext*,
+            const PQL::Condition*)
+        {
+            _queues[worker].push_back(id);
+        }
+
+        size_t BFSStealingQueue::_pop(uint32_t worker)
+        {
+            auto& q = _queues[worker];
+            if(q.empty()) return EMPTY;
+            auto r = q.front();
+            q.pop_front();
+            return r;
+        }
+
+        size_t BFSStealingQueue::_steal(uint32_t, uint32_t victim)
+        {
+            // the oldest state is also the shallowest
+            return _pop(victim);
+        }
+
+        DFSStealingQueue::DFSStealingQueue(size_t seed, uint32_t workers)
+        : StealingQueue(seed, workers), _stacks(std::max<uint32_t>(workers, 1)) {}
+
+        void DFSStealingQueue::_push(uint32_t worker, size_t id, PQL::DistanceContext*,
+            const PQL::Condition*)
+        {
+            _stacks[worker].push_back(id);
+        }
+
+        size_t DFSStealingQueue::_pop(uint32_t worker)
+        {
+            auto& s = _stacks[worker];
+            if(s.empty()) return EMPTY;
+            uint32_t n = s.back();
+            s.pop_back();
+            return n;
+        }
+
+        size_t DFSStealingQueue::_steal(uint32_t, uint32_t victim)
+        {
+            // steal from the bottom, leaving the victim its current branch
+            auto& s = _stacks[victim];
+            if(s.empty()) return EMPTY;
+            uint32_t n = s.front();
+            s.pop_front();
+            return n;
+        }
+
+        RDFSStealingQueue::RDFSStealingQueue(size_t seed, uint32_t workers)
+        : StealingQueue(seed, workers), _stacks(std::max<uint32_t>(workers, 1)),
+          _caches(std::max<uint32_t>(workers, 1))
+        {
+            for(uint32_t i = 0; i < std::max<uint32_t>(workers, 1); ++i)
+                _rngs.emplace_back(seed + i);
+        }
+
+        void RDFSStealingQueue::_push(uint32_t worker, size_t id, PQL::DistanceContext*,
+            const PQL::Condition*)
+        {
+            _caches[worker].push_back(id);
+        }
+
+        size_t RDFSStealingQueue::_pop(uint32_t worker)
+        {
+            auto& cache = _caches[worker];
+            auto& stack = _stacks[worker];
+            if(cache.empty())
+            {
+                if(stack.empty())
+                    return EMPTY;
+                uint32_t n = stack.back();
+                stack.pop_back();
+                return n;
+            }
+            else
+            {
+                std::shuffle(cache.begin(), cache.end(), _rngs[worker]);
+                uint32_t n = cache.back();
+                for(size_t i = 0; i < (cache.size() - 1); ++i)
+                {
+                    stack.push_back(cache[i]);
+                }
+                cache.clear();
+                return n;
+            }
+        }
+
+        size_t RDFSStealingQueue::_steal(uint32_t, uint32_t victim)
+        {
+            auto& stack = _stacks[victim];
+            if(!stack.empty())
+            {
+                uint32_t n = stack.front();
+                stack.pop_front();
+                return n;
+            }
+            auto& cache = _caches[victim];
+            if(cache.empty()) return EMPTY;
+            uint32_t n = cache.back();
+            cache.pop_back();
+            return n;
+        }
+
+        HeuristicStealingQueue::HeuristicStealingQueue(size_t seed, uint32_t workers)
+        : StealingQueue(seed, workers), _queues(std::max<uint32_t>(workers, 1))
+        {
+            _best = std::make_unique<std::atomic<uint32_t>[]>(_queues.size());
+            for(size_t i = 0; i < _queues.size(); ++i)
+                _best[i] = std::numeric_limits<uint32_t>::max();
+        }
+
+        void HeuristicStealingQueue::_push(uint32_t worker, size_t id, PQL::DistanceContext* context,
+            const PQL::Condition* query)
+        {
+            // invert result, highest numbers are on top!
+            uint32_t dist = query->distance(*context);
+            _queues[worker].emplace(dist, (uint32_t)id);
+            _best[worker] = _queues[worker].top().weight;
+        }
+
+        size_t HeuristicStealingQueue::_pop(uint32_t worker)
+        {
+            auto& q = _queues[worker];
+            if(q.empty()) return EMPTY;
+            uint32_t n = q.top().item;
+            q.pop();
+            _best[worker] = q.empty() ? std::numeric_limits<uint32_t>::max() : q.top().weight;
+            return n;
+        }
+
+        size_t HeuristicStealingQueue::_steal(uint32_t, uint32_t victim)
+        {
+            return _pop(victim);
+        }
+
+        uint32_t HeuristicStealingQueue::_victim(uint32_t thief, uint32_t attempt)
+        {
+            // first go for the globally best looking heap, then round-robin.
+            // the weights are read without locks, hence the stealing is only
+            // approximately best-first.
+            if(attempt == 0)
+            {
+                uint32_t victim = thief;
+                uint32_t best = std::numeric_limits<uint32_t>::max();
+                for(uint32_t i = 0; i < _queues.size(); ++i)
+                {
+                    if(i == thief) continue;
+                    uint32_t w = _best[i];
+                    if(w < best)
+                    {
+                        best = w;
+                        victim = i;
+                    }
+                }
+                return victim;
+            }
+            return StealingQueue::_victim(thief, attempt - 1);
+        }
+    }
+}
@@ -83,6 +83,20 @@ void options_t::print(std::ostream& optionsOut) {
 
     optionsOut << ",LPSolve_Timeout=" << lpsolveTimeout;
 
+    if (statestore == StateStore::Hash) {
+        optionsOut << ",State_Store=HASH,Hash_Size=" << hashsize;
+    } else if (statestore == StateStore::Bitstate) {
+        optionsOut << ",State_Store=BITSTATE,Bitstate_Size=" << bitstatesize << ",Bitstate_Hashes=" << bitstatehashes;
+    }
+
+    if (memorylimit != 0) {
+        optionsOut << ",Memory_Limit=" << memorylimit;
+    }
+
+    if (adaptiveencoding) {
+        optionsOut << ",Adaptive_Encoding=ENABLED";
+    }
+
 
     if (usedctl) {
         if (ctlalgorithm == CTL::CZero) {
@@ -90,6 +104,18 @@ void options_t::print(std::ostream& optionsOut) {
         } else {
             optionsOut << ",CTLAlgorithm=LOCAL";
         }
+        if (ctlsuccessorcache > 0) {
+            optionsOut << ",CTL_Successor_Cache=" << ctlsuccessorcache;
+        }
+        if (ctltimebudget > 0) {
+            optionsOut << ",CTL_Time_Budget=" << ctltimebudget;
+        }
+        if (ctlmemorybudget > 0) {
+            optionsOut << ",CTL_Memory_Budget=" << ctlmemorybudget;
+        }
+        if (ctlbatch) {
+            optionsOut << ",CTL_Batch=ENABLED";
+        }
     } else if (usedltl) {
         switch (ltlalgorithm) {
             case LTL::Algorithm::NDFS:
@@ -98,6 +124,9 @@ void options_t::print(std::ostream& optionsOut) {
             case LTL::Algorithm::Tarjan:
                 optionsOut << ",LTLAlgorithm=Tarjan";
                 break;
+            case LTL::Algorithm::CNDFS:
+                optionsOut << ",LTLAlgorithm=CNDFS";
+                break;
             case LTL::Algorithm::None:
                 optionsOut << ",LTLAlgorithm=None";
                 break;
@@ -115,6 +144,7 @@ void printHelp() {
         "Options:\n"
         "  -k, --k-bound <number of tokens>     Token bound, 0 to ignore (default)\n"
         "  -t, --trace                          Provide XML-trace to stderr\n"
+        "                                       CTL traces have a <branch> per successor on A-paths\n"
         "  -s, --search-strategy <strategy>     Search strategy:\n"
         "                                       - BestFS       Heuristic search (default)\n"
         "                                       - BFS          Breadth first search\n"
@@ -123,6 +153,20 @@ void printHelp() {
         "                                       - OverApprox   Linear Over Approx\n"
         "  --seed-offset <number>               Extra noise to add to the seed of the random number generation\n"
         "  -e, --state-space-exploration        State-space exploration only (query-file is irrelevant)\n"
+        "  --state-store <type>                 Storage of the markings during reachability search:\n"
+        "                                       - ptrie    Compressed prefix trie (default)\n"
+        "                                       - hash     Lock-free hash table of fixed size, see --hash-size\n"
+        "                                       - bitstate Bitstate hashing, only a few bits per marking are kept,\n"
+        "                                                  may miss markings (exhaustive answers are inconclusive)\n"
+        "  --hash-size <n>                      Use 2^n slots of about 26 bytes in the hash state store\n"
+        "                                       (default 22, at most 30)\n"
+        "  --bitstate-size <n>                  Use 2^n bits in the bitstate state store (default 30)\n"
+        "  --bitstate-hashes <k>                Number of bits set per marking in the bitstate state store (default 3)\n"
+        "  --memory-limit <MB>                  Move the reachability state space to disk once it exceeds the limit\n"
+        "  --trace-checkpoint <n>               With --trace, store only every n-th marking on a path in full and the\n"
+        "                                       others as the transition from their parent (default 1)\n"
+        "  --adaptive-encoding                  Pack each place of the stored markings into the number of bits\n"
+        "                                       needed by the markings seen so far (sequential search only)\n"
         "  -x, --xml-queries <query index>      Parse XML query file and verify queries of a given comma-seperated list\n"
         "  -r, --reduction <type>               Change structural net reduction:\n"
         "                                       - 0  disabled\n"
@@ -159,9 +203,20 @@ void printHelp() {
         "  -ctl, --ctl-algorithm [<type>]       Verify CTL properties\n"
         "                                       - local     Liu and Smolka's on-the-fly algorithm\n"
         "                                       - czero     local with certain zero extension (default)\n"
+        "  --ctl-successor-cache <markings>     Cache the successor markings of up to <markings> markings\n"
+        "                                       for the CTL engine (default 0, disabled)\n"
+        "  --ctl-time-budget <seconds>          Stop solving a CTL query after <seconds>, over all its fixed\n"
+        "                                       point searches, and answer CANNOT_COMPUTE (default 0, unlimited)\n"
+        "  --ctl-memory-budget <MB>             As --ctl-time-budget, once the dependency graph holds <MB>\n"
+        "  --ctl-progress <seconds>             Print a PROGRESS record with the explored configurations, the\n"
+        "                                       processed edges, the waiting edges and the edges per second\n"
+        "                                       to stderr every <seconds> of a CTL search (default 0, disabled)\n"
+        "  --ctl-batch                          Share structurally equal subformulas between the CTL queries\n"
+        "                                       and order the queries to reuse their results\n"
         "  -ltl, --ltl-algorithm [<type>]       Verify LTL properties (default tarjan). If omitted the queries are assumed to be CTL.\n"
         "                                       - ndfs      Nested depth first search algorithm\n"
         "                                       - tarjan    On-the-fly Tarjan's algorithm\n"
+        "                                       - cndfs     Multi-core nested depth first search on --threads threads\n"
         "                                       - none      Run preprocessing steps only.\n"
         "  --noweak                             Disable optimizations for weak Büchi automata when doing \n"
         "                                       LTL model checking. Not recommended.\n"
@@ -172,8 +227,11 @@ void printHelp() {
         "  --disable-partitioning               Disable the partitioning of colors in the Petri Net (CPN only)\n"
         "  --disable-symmetry-vars              Disable search for symmetric variables (CPN only)\n"
 #ifdef VERIFYPN_MC_Simplification
-        "  -z, --cores <number of cores>        Number of cores to use (currently only query simplification)\n"
+        "  -z, --cores <number of cores>        Number of cores to use for query simplification (default 1)\n"
 #endif
+        "  --threads <number of threads>        Number of threads to use for state-space exploration, the czero\n"
+        "                                       CTL algorithm and the cndfs LTL algorithm (default 1).\n"
+        "                                       Stubborn sets are disabled for the first two when above 1.\n"
         "  -tar, --trace-abstraction            Enables Trace Abstraction Refinement for reachability properties\n"
         "  --max-intervals <interval count>     The max amount of intervals kept when computing the color fixpoint\n"
         "                  <interval count>     Default is 250 and then after <interval-timeout> second(s) to 5\n"
@@ -199,9 +257,13 @@ void printHelp() {
         "  --trace-replay <file>                Replays a trace as output by the --trace option.\n"
         "                                       The trace is verified against the provided model and query.\n"
         "                                       Mainly useful for debugging.\n"
-        "  --spot-optimization <1,2,3>          The optimization level passed to Spot for Büchi automaton creation.\n"
-        "                                       1: Low (default), 2: Medium, 3: High\n"
+        "  --spot-optimization <0,1,2,3>        The optimization level passed to Spot for Büchi automaton creation.\n"
+        "                                       0: On the fly, 1: Low (default), 2: Medium, 3: High\n"
         "                                       Using optimization levels above 1 may cause exponential blowups and is not recommended.\n"
+        "                                       Level 0 skips the translation and builds the states of an unoptimized\n"
+        "                                       automaton as the search reaches them. The automaton partial order\n"
+        "                                       (--ltl-por automaton), cndfs and --write-buchi still build all of it,\n"
+        "                                       and the automaton heuristic is replaced by the distance heuristic.\n"
         "  --strategy-output <file>             Outputs the synthesized strategy (if a such exist) to <filename>\n"
         "                                           Use '-' (dash) for outputting to standard output.\n"
         "\n"
@@ -295,6 +357,61 @@ bool options_t::parse(int argc, const char** argv) {
             } else {
                 trace = TraceLevel::Full;
             }
+        } else if (std::strcmp(argv[i], "--state-store") == 0 || std::strncmp(argv[i], "--state-store=", 14) == 0) {
+            const char* s = nullptr;
+            if (argv[i][13] == '=') {
+                s = argv[i] + 14;
+            } else if (i == argc - 1) {
+                throw base_error("Missing state store after ", std::quoted(argv[i]));
+            } else {
+                s = argv[++i];
+            }
+            if (std::strcmp(s, "ptrie") == 0)
+                statestore = StateStore::PTrie;
+            else if (std::strcmp(s, "hash") == 0)
+                statestore = StateStore::Hash;
+            else if (std::strcmp(s, "bitstate") == 0)
+                statestore = StateStore::Bitstate;
+            else {
+                throw base_error("Argument Error: Unrecognized state store ", std::quoted(s));
+            }
+        } else if (std::strcmp(argv[i], "--hash-size") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%u", &hashsize) != 1 || hashsize < 8 || hashsize > 30) {
+                throw base_error("Argument Error: Invalid hash size ", std::quoted(argv[i]), ", expected a number between 8 and 30");
+            }
+        } else if (std::strcmp(argv[i], "--bitstate-size") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%u", &bitstatesize) != 1 || bitstatesize < 6 || bitstatesize > 40) {
+                throw base_error("Argument Error: Invalid bitstate size ", std::quoted(argv[i]), ", expected a number between 6 and 40");
+            }
+        } else if (std::strcmp(argv[i], "--bitstate-hashes") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%u", &bitstatehashes) != 1 || bitstatehashes == 0 || bitstatehashes > 32) {
+                throw base_error("Argument Error: Invalid number of bitstate hashes ", std::quoted(argv[i]), ", expected a number between 1 and 32");
+            }
+        } else if (std::strcmp(argv[i], "--memory-limit") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%zu", &memorylimit) != 1) {
+                throw base_error("Argument Error: Invalid memory limit ", std::quoted(argv[i]));
+            }
+        } else if (std::strcmp(argv[i], "--trace-checkpoint") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%u", &tracecheckpoint) != 1 || tracecheckpoint == 0) {
+                throw base_error("Argument Error: Invalid trace checkpoint interval ", std::quoted(argv[i]));
+            }
+        } else if (std::strcmp(argv[i], "--adaptive-encoding") == 0) {
+            adaptiveencoding = true;
         } else if (std::strcmp(argv[i], "-x") == 0 || std::strcmp(argv[i], "--xml-queries") == 0) {
             if (i == argc - 1) {
                 throw base_error("Missing number after ", std::quoted(argv[i]));
@@ -416,6 +533,8 @@ bool options_t::parse(int argc, const char** argv) {
         } else if (std::strcmp(argv[i], "--spot-optimization") == 0) {
             if (argc == i + 1) {
                 throw base_error("Missing argument to --spot-optimization");
+            } else if (std::strcmp(argv[i + 1], "0") == 0) {
+                buchiOptimization = LTL::BuchiOptimization::OnTheFly;
             } else if (std::strcmp(argv[i + 1], "1") == 0) {
                 buchiOptimization = LTL::BuchiOptimization::Low;
             } else if (std::strcmp(argv[i + 1], "2") == 0) {
@@ -431,15 +550,23 @@ bool options_t::parse(int argc, const char** argv) {
             replay_file = std::string(argv[++i]);
         }
 #ifdef VERIFYPN_MC_Simplification
-        else if (std::strcmp(argv[i], "-z") == 0) {
+        else if (std::strcmp(argv[i], "-z") == 0 || std::strcmp(argv[i], "--cores") == 0) {
             if (i == argc - 1) {
                 throw base_error("Missing number after ", std::quoted(argv[i]));
             }
-            if (sscanf(argv[++i], "%u", &cores) != 1) {
+            if (sscanf(argv[++i], "%u", &cores) != 1 || cores == 0) {
                 throw base_error("Argument Error: Invalid cores count ", std::quoted(argv[i]));
             }
         }
 #endif
+        else if (std::strcmp(argv[i], "--threads") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%u", &threads) != 1 || threads == 0) {
+                throw base_error("Argument Error: Invalid threads count ", std::quoted(argv[i]));
+            }
+        }
         else if (std::strcmp(argv[i], "--keep-solved") == 0)
         {
             keep_solved = true;
@@ -458,6 +585,36 @@ bool options_t::parse(int argc, const char** argv) {
                 }
                 i++;
             }
+        } else if (std::strcmp(argv[i], "--ctl-successor-cache") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%zu", &ctlsuccessorcache) != 1) {
+                throw base_error("Argument Error: Invalid successor cache size ", std::quoted(argv[i]));
+            }
+        } else if (std::strcmp(argv[i], "--ctl-time-budget") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%u", &ctltimebudget) != 1) {
+                throw base_error("Argument Error: Invalid CTL time budget ", std::quoted(argv[i]));
+            }
+        } else if (std::strcmp(argv[i], "--ctl-memory-budget") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%zu", &ctlmemorybudget) != 1) {
+                throw base_error("Argument Error: Invalid CTL memory budget ", std::quoted(argv[i]));
+            }
+        } else if (std::strcmp(argv[i], "--ctl-progress") == 0) {
+            if (i == argc - 1) {
+                throw base_error("Missing number after ", std::quoted(argv[i]));
+            }
+            if (sscanf(argv[++i], "%u", &ctlprogress) != 1) {
+                throw base_error("Argument Error: Invalid CTL progress interval ", std::quoted(argv[i]));
+            }
+        } else if (std::strcmp(argv[i], "--ctl-batch") == 0) {
+            ctlbatch = true;
         } else if (std::strcmp(argv[i], "-ltl") == 0 || std::strcmp(argv[i], "--ltl-algorithm") == 0) {
             logic = TemporalLogic::LTL;
             if (argc > i + 1) {
@@ -465,6 +622,8 @@ bool options_t::parse(int argc, const char** argv) {
                     ltlalgorithm = LTL::Algorithm::NDFS;
                 } else if (std::strcmp(argv[i + 1], "tarjan") == 0) {
                     ltlalgorithm = LTL::Algorithm::Tarjan;
+                } else if (std::strcmp(argv[i + 1], "cndfs") == 0) {
+                    ltlalgorithm = LTL::Algorithm::CNDFS;
                 } else if (std::strcmp(argv[i + 1], "none") == 0) {
                     ltlalgorithm = LTL::Algorithm::None;
                 } else {
@@ -607,6 +766,28 @@ bool options_t::parse(int argc, const char** argv) {
         }
     }
 
+    if (memorylimit != 0) {
+        if (trace != TraceLevel::None) {
+            throw base_error("Argument Error: --memory-limit is not compatible with traces.");
+        }
+        if (threads > 1 || statestore != StateStore::PTrie) {
+            throw base_error("Argument Error: --memory-limit requires a single thread and the ptrie state store.");
+        }
+    }
+
+    if (adaptiveencoding && (threads > 1 || statestore == StateStore::Hash)) {
+        throw base_error("Argument Error: --adaptive-encoding requires a single thread and is not supported by the hash state store.");
+    }
+
+    if (statestore == StateStore::Bitstate) {
+        if (trace != TraceLevel::None) {
+            throw base_error("Argument Error: The bitstate state store is not compatible with traces.");
+        }
+        if (threads > 1) {
+            throw base_error("Argument Error: The bitstate state store requires a single thread.");
+        }
+    }
+
     if (false && replay_trace && logic != TemporalLogic::LTL) {
         throw base_error("Argument Error: Trace replay_trace is only supported for LTL model checking.");
     }
@@ -355,7 +355,8 @@ int main(int argc, const char** argv) {
                                  querynames,
                                  queries,
                                  ctl_ids,
-                                 options);
+                                 options,
+                                 builder.getReducer());
 
                 if (std::find(results.begin(), results.end(), ResultPrinter::Unknown) == results.end()) {
                     return to_underlying(v);
@@ -373,7 +374,7 @@ int main(int argc, const char** argv) {
                     LTL::LTLSearch search(*net, queries[qid], options.buchiOptimization, options.ltl_compress_aps);
                     auto res = search.solve(options.trace != TraceLevel::None, options.kbound,
                         options.ltlalgorithm, options.stubbornreduction ? options.ltl_por : LTL::LTLPartialOrder::None,
-                        options.strategy, options.ltlHeuristic, options.ltluseweak, options.seed_offset);
+                        options.strategy, options.ltlHeuristic, options.ltluseweak, options.seed_offset, options.threads);
 
                     if(options.printstatistics)
                         search.print_stats(std::cout);
@@ -476,6 +477,22 @@ int main(int argc, const char** argv) {
                 // Change default place-holder to default strategy
                 if (options.strategy == Strategy::DEFAULT) options.strategy = Strategy::HEUR;
 
+                // stubborn sets are not (yet) supported by the parallel exploration
+                if (options.threads > 1 && options.stubbornreduction) {
+                    std::cerr << "Warning: stubborn sets are not supported with --threads above 1, using full expansion" << std::endl;
+                    options.stubbornreduction = false;
+                }
+
+                StoreOptions store;
+                store.threads = options.threads;
+                store.store = options.statestore;
+                store.hashsize = options.hashsize;
+                store.memorylimit = options.memorylimit * 1024 * 1024;
+                store.tracecheckpoint = options.tracecheckpoint;
+                store.bitstatesize = options.bitstatesize;
+                store.bitstatehashes = options.bitstatehashes;
+                store.adaptiveencoding = options.adaptiveencoding;
+
                 //Reachability search
                 strategy.reachable(queries, results,
                                    options.strategy,
@@ -483,7 +500,8 @@ int main(int argc, const char** argv) {
                                    options.statespaceexploration,
                                    options.printstatistics,
                                    options.trace != TraceLevel::None,
-                                   options.seed());
+                                   options.seed(),
+                                   store);
             }
         }
     } catch (base_error& e) {